@@ -0,0 +1,658 @@
+/*********************************************************************************************************
+* Tatyana Vlaskin (vlaskint@onid.oregonstate.edu)
+* OregonState EECS
+* Filename: libsmallsh.c
+*
+* Description: Parsing and launching of smallsh command lines, see libsmallsh.h for the interface.
+* This code used to be split_Users_Command_into_Arguments(), file_Name(), foreground_Command() and
+* background_Command() in smallsh.c. The shell itself now only reads lines and handles the built in commands.
+* Children are started with clone3(CLONE_PIDFD), tracked with the pidfd and waited for with poll(), see
+* http://man7.org/linux/man-pages/man2/pidfd_open.2.html
+******************************************************************************************************************/
+// for pipe2() and WCOREFLAG
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include <stdint.h>
+#include <linux/sched.h>
+
+#include "libsmallsh.h"
+#include "metrics.h"
+#include "variables.h"
+
+// the environment of this process, execvp uses it unless we are given another one
+extern char **environ;
+
+// waitid() id type for a pidfd (Linux 5.4), older headers do not have it
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+
+ /*************************************************************************************************************
+ * Function:  static pid_t fork_Process(int *pid_Fd)
+ * Description: Function is fork() that also gives the parent a pidfd for the child. The pidfd becomes readable
+ * when the child is done, and waiting and signalling through it can never reach another process that reused the pid.
+ * clone3() with CLONE_PIDFD (Linux 5.3) makes the pidfd together with the child, so there is no moment in which
+ * the pid is all we have. For the child it is the same as fork(), glibc's fork handlers just do not run, which is
+ * fine because the child only makes system calls before execvp. Without clone3 (older kernels, or a seccomp
+ * filter that refuses it) we fork() and open the pidfd with pidfd_open() right after.
+ * glibc has no wrapper for clone3 and only has pidfd_open since 2.36, so we make the system calls ourselves.
+ * Parameters: where to store the pidfd, it is -1 if the kernel does not support pidfds
+ * returns what fork() returns
+ ***************************************************************************************************************/
+static pid_t fork_Process(int *pid_Fd){
+	pid_t pid;
+	*pid_Fd = -1;
+#if defined(SYS_clone3) && defined(CLONE_PIDFD)
+	{
+		struct clone_args clone_Arguments;
+		memset(&clone_Arguments, 0, sizeof(clone_Arguments));
+		clone_Arguments.flags = CLONE_PIDFD;
+		clone_Arguments.pidfd = (uint64_t)(uintptr_t)pid_Fd;
+		clone_Arguments.exit_signal = SIGCHLD;
+		pid = (pid_t)syscall(SYS_clone3, &clone_Arguments, sizeof(clone_Arguments));
+		if (pid >= 0 || (errno != ENOSYS && errno != EPERM)){
+			return pid;
+		}
+	}
+#endif
+	pid = fork();
+#ifdef SYS_pidfd_open
+	if (pid > 0){
+		*pid_Fd = (int)syscall(SYS_pidfd_open, pid, 0);
+	}
+#endif
+	return pid;
+}
+
+ /*************************************************************************************************************
+ * Function:  static long long milliseconds_Now(void)
+ * Description: Function returns a monotonic time stamp in milliseconds, used for the wait deadlines
+ ***************************************************************************************************************/
+static long long milliseconds_Now(void){
+	return metrics_Now() / 1000000;
+}
+
+ /*************************************************************************************************************
+ * Function:  static int read_Captured_Output(struct command_Handle *handle)
+ * Description: Function reads what is available right now from the capture pipe into the captured output
+ * buffer, growing the buffer as needed. The pipe is non blocking, so this never waits for more.
+ * Parameters: handle
+ * returns 0 - on success, returns -1 - if we ran out of memory or read() failed
+ ***************************************************************************************************************/
+static int read_Captured_Output(struct command_Handle *handle){
+	if (handle->capture_Fd < 0){
+		return 0;
+	}
+	while (1){
+		// keep at least one byte free for the NUL terminator
+		if (handle->captured_Capacity - handle->captured_Length < 2){
+			size_t new_Capacity = handle->captured_Capacity ? handle->captured_Capacity * 2 : 4096;
+			char *new_Buffer = realloc(handle->captured_Output, new_Capacity);
+			if (new_Buffer == NULL){
+				snprintf(handle->error_Message, MAX_STATUS_CHARACTERS, "smallsh: out of memory capturing output");
+				return -1;
+			}
+			handle->captured_Output = new_Buffer;
+			handle->captured_Capacity = new_Capacity;
+		}
+		ssize_t bytes_Read = read(handle->capture_Fd, handle->captured_Output + handle->captured_Length,
+		                          handle->captured_Capacity - handle->captured_Length - 1);
+		if (bytes_Read > 0){
+			handle->captured_Length += bytes_Read;
+			handle->captured_Output[handle->captured_Length] = '\0';
+			continue;
+		}
+		if (bytes_Read == 0){
+			// end of file, the command and everybody sharing its output are done writing
+			close(handle->capture_Fd);
+			handle->capture_Fd = -1;
+			return 0;
+		}
+		if (errno == EINTR){
+			continue;
+		}
+		if (errno == EAGAIN || errno == EWOULDBLOCK){
+			return 0;
+		}
+		snprintf(handle->error_Message, MAX_STATUS_CHARACTERS, "smallsh: reading output: %s", strerror(errno));
+		return -1;
+	}
+}
+
+ /*************************************************************************************************************
+ * Function:  static void record_Wait_Status(struct command_Handle *handle, int status)
+ * Description: Function translates the wait status of the reaped child into the handle fields
+ * Parameters: handle and status returned by wait4()
+ ***************************************************************************************************************/
+static void record_Wait_Status(struct command_Handle *handle, int status){
+	handle->finished = 1;
+	handle->wait_Status = status;
+	handle->exit_Value = -1;
+	handle->signal_Number = 0;
+	//http://man7.org/linux/man-pages/man2/wait.2.html
+	if (WIFEXITED(status)){
+		handle->exit_Value = WEXITSTATUS(status);
+	}
+	if (WIFSIGNALED(status)){
+		handle->signal_Number = WTERMSIG(status);
+		count_Metric(METRIC_COMMANDS_SIGNALED);
+	}
+	// a background command is only reaped when somebody gets round to it, that would be measured instead
+	if (!handle->background){
+		observe_Metric(METRIC_COMMAND_SECONDS, metrics_Now() - handle->launch_Time);
+	}
+}
+
+ /*************************************************************************************************************
+ * Function:  static int reap_Command(struct command_Handle *handle, int wait_Options)
+ * Description: Function reaps the child of the handle and gets its resource usage. With a pidfd it is the
+ * waitid(P_PIDFD) system call, which takes the rusage as a fifth argument the glibc wrapper does not have, so a
+ * process that reused the pid of our child can never be reaped instead. Without one it is wait4() on the pid.
+ * Parameters: handle and 0 or WNOHANG
+ * returns 1 - the child was reaped, returns 0 - still running (WNOHANG), returns -1 - error
+ ***************************************************************************************************************/
+static int reap_Command(struct command_Handle *handle, int wait_Options){
+	int status = 0;
+	pid_t pid_Child;
+	if (handle->pid_Fd >= 0){
+		siginfo_t child_Info;
+		int result;
+		// si_pid stays 0 if WNOHANG finds the child still running
+		memset(&child_Info, 0, sizeof(child_Info));
+		while ((result = (int)syscall(SYS_waitid, P_PIDFD, handle->pid_Fd, &child_Info, WEXITED | wait_Options, &handle->usage)) < 0 && errno == EINTR){
+		}
+		// EINVAL is a kernel without P_PIDFD (5.3), the pid is the best we have then
+		if (result == 0 || errno != EINVAL){
+			if (result < 0){
+				snprintf(handle->error_Message, MAX_STATUS_CHARACTERS, "smallsh: waiting for pid %d: %s", (int)handle->pid, strerror(errno));
+				return -1;
+			}
+			if (child_Info.si_pid == 0){
+				return 0;
+			}
+			// put it back together as the status waitpid would have given us
+			if (child_Info.si_code == CLD_EXITED){
+				status = (child_Info.si_status & 0xff) << 8;
+			}
+			else{
+				status = child_Info.si_status | (child_Info.si_code == CLD_DUMPED ? WCOREFLAG : 0);
+			}
+			record_Wait_Status(handle, status);
+			return 1;
+		}
+	}
+	while ((pid_Child = wait4(handle->pid, &status, wait_Options, &handle->usage)) < 0){
+		if (errno != EINTR){
+			snprintf(handle->error_Message, MAX_STATUS_CHARACTERS, "smallsh: waiting for pid %d: %s", (int)handle->pid, strerror(errno));
+			return -1;
+		}
+	}
+	if (pid_Child == 0){
+		return 0;
+	}
+	record_Wait_Status(handle, status);
+	return 1;
+}
+
+int parse_Command_Line(const char *input_Command, struct parsed_Command *parsed_Line){
+	char *current_Token;
+	char **pending_File = NULL; // set when the last word was < or >, the next word is the file name
+	char *equal_Sign;
+	char *token_Position; // strtok_r keeps its place here instead of in hidden static state
+	long long parse_Start = metrics_Now();
+	// only the fields are cleared, the arrays are NULL terminated below and clearing them all would be 10KB
+	parsed_Line->argument_Count = 0;
+	parsed_Line->assignment_Count = 0;
+	parsed_Line->input_File = NULL;
+	parsed_Line->output_File = NULL;
+	parsed_Line->background = 0;
+	parsed_Line->error_Message[0] = '\0';
+	if (strlen(input_Command) >= MAX_CHARACTERS){
+		snprintf(parsed_Line->error_Message, MAX_STATUS_CHARACTERS, "smallsh: command line too long");
+		return -1;
+	}
+	// we work on our own copy so the words can point into it and the caller's string is left alone
+	//the length was checked above, so copying the NUL terminator too always fits
+	memcpy(parsed_Line->line_Buffer, input_Command, strlen(input_Command) + 1);
+	//strtok_r will tokenize a string i.e. convert it into a series of substrings.
+	//it is the thread safe strtok, programs embedding us may parse from several threads at once
+	//in our case the delimiters are white space characters
+	//http://codereview.stackexchange.com/questions/42990/tokenizing-string-using-strtok
+	current_Token = strtok_r(parsed_Line->line_Buffer, " \t\n", &token_Position);
+	while (current_Token != NULL){
+		if (pending_File != NULL){
+			*pending_File = current_Token;
+			pending_File = NULL;
+		}
+		else if (strcmp(current_Token, "<") == 0){
+			pending_File = &parsed_Line->input_File;
+		}
+		else if (strcmp(current_Token, ">") == 0){
+			pending_File = &parsed_Line->output_File;
+		}
+		else if (strcmp(current_Token, "&") == 0){
+			// the & word must be the last word, anything after it is ignored
+			parsed_Line->background = 1;
+			break;
+		}
+		// NAME=value words in front of the command are variable assignments for that command
+		else if (parsed_Line->argument_Count == 0 && parsed_Line->input_File == NULL && parsed_Line->output_File == NULL &&
+		         (equal_Sign = strchr(current_Token, '=')) != NULL && valid_Variable_Name(current_Token, equal_Sign - current_Token)){
+			if (parsed_Line->assignment_Count == MAX_ASSIGNMENTS - 1){
+				snprintf(parsed_Line->error_Message, MAX_STATUS_CHARACTERS, "smallsh: too many variable assignments");
+				return -1;
+			}
+			parsed_Line->assignments[parsed_Line->assignment_Count++] = current_Token;
+		}
+		else if (parsed_Line->input_File == NULL && parsed_Line->output_File == NULL){
+			// arguments have to come before the redirections
+			if (parsed_Line->argument_Count == MAX_ARGUMENTS - 1){
+				snprintf(parsed_Line->error_Message, MAX_STATUS_CHARACTERS, "smallsh: too many arguments");
+				return -1;
+			}
+			parsed_Line->argv[parsed_Line->argument_Count++] = current_Token;
+		}
+		current_Token = strtok_r(NULL, " \t\n", &token_Position);
+	}
+	if (pending_File != NULL){
+		snprintf(parsed_Line->error_Message, MAX_STATUS_CHARACTERS, "smallsh: missing file name after redirection");
+		return -1;
+	}
+	// Add the null terminator to the end of the array
+	parsed_Line->argv[parsed_Line->argument_Count] = NULL;
+	parsed_Line->assignments[parsed_Line->assignment_Count] = NULL;
+	observe_Metric(METRIC_PARSE_SECONDS, metrics_Now() - parse_Start);
+	return 0;
+}
+
+ /*************************************************************************************************************
+ * Function:  static char **merge_Environment(char *const *environment, char *const *assignments, int assignment_Count)
+ * Description: Function builds the environment for a command with NAME=value assignments in front of it:
+ * every entry of environment whose name is not assigned, followed by the assignments. When the same
+ * name is assigned twice the last assignment wins. Only pointers are copied.
+ * returns a malloc'd NULL terminated array, or NULL if we ran out of memory
+ ***************************************************************************************************************/
+static char **merge_Environment(char *const *environment, char *const *assignments, int assignment_Count){
+	size_t environment_Count = 0;
+	size_t entry_Number = 0;
+	char **merged;
+	int i;
+	int j;
+	while (environment[environment_Count] != NULL){
+		environment_Count++;
+	}
+	merged = malloc((environment_Count + assignment_Count + 1) * sizeof(char *));
+	if (merged == NULL){
+		return NULL;
+	}
+	for (i = 0; environment[i] != NULL; i++){
+		size_t name_Length = strcspn(environment[i], "=");
+		int assigned = 0;
+		for (j = 0; j < assignment_Count && !assigned; j++){
+			assigned = (strncmp(environment[i], assignments[j], name_Length) == 0 && assignments[j][name_Length] == '=');
+		}
+		if (!assigned){
+			merged[entry_Number++] = environment[i];
+		}
+	}
+	for (i = 0; i < assignment_Count; i++){
+		size_t name_Length = strcspn(assignments[i], "=");
+		int assigned_Again = 0;
+		for (j = i + 1; j < assignment_Count && !assigned_Again; j++){
+			assigned_Again = (strncmp(assignments[i], assignments[j], name_Length + 1) == 0);
+		}
+		if (!assigned_Again){
+			merged[entry_Number++] = assignments[i];
+		}
+	}
+	merged[entry_Number] = NULL;
+	return merged;
+}
+
+int launch_Command(const struct parsed_Command *parsed_Line, int launch_Flags, struct command_Handle *handle){
+	return launch_Command_Environment(parsed_Line, launch_Flags, NULL, handle);
+}
+
+int launch_Command_Environment(const struct parsed_Command *parsed_Line, int launch_Flags, char *const *environment, struct command_Handle *handle){
+	int input_Fd = -1;
+	int output_Fd = -1;
+	int capture_Pipe[2] = {-1, -1};
+	int exec_Error_Pipe[2] = {-1, -1}; // the child writes errno here if execvp fails
+	struct sigaction act;
+	char **merged_Environment = NULL; // environment plus the NAME=value words of the command line
+	int take_Terminal = 0;
+	memset(handle, 0, sizeof(*handle));
+	handle->pid = -1;
+	handle->pid_Fd = -1;
+	handle->capture_Fd = -1;
+	handle->exit_Value = -1;
+	handle->launch_Time = metrics_Now();
+	handle->background = parsed_Line->background;
+	if (parsed_Line->argument_Count == 0){
+		snprintf(handle->error_Message, MAX_STATUS_CHARACTERS, "smallsh: no command");
+		return -1;
+	}
+	// Every descriptor we make here is close on exec from the start. Another thread of the program may be
+	//launching a command at the same time, its child must not inherit our redirection files or pipes.
+	//dup2() in our child clears the flag on the copies that become 0 and 1
+	// Get the file descriptor if we have to redirect input
+	//O_RDONLY the redirected input file will be opened for reading only
+	if (parsed_Line->input_File != NULL){
+		input_Fd = open(parsed_Line->input_File, O_RDONLY | O_CLOEXEC);
+		if (input_Fd < 0){
+			snprintf(handle->error_Message, MAX_STATUS_CHARACTERS, "smallsh: cannot open %s for input", parsed_Line->input_File);
+			count_Metric(METRIC_REDIRECT_FAILURES);
+			return -1;
+		}
+	}
+	//if the user did not specify redirection for a background command, redirect stdin to dev/null
+	//dev/null is a black hole where any data sent, will be discarded
+	else if (parsed_Line->background){
+		input_Fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	}
+	// Get the file descriptor if we have to redirect output
+	//it should be truncated if it already exists or created if it does not exist.
+	//0644 will create a file that is Read/Write for owner, and Read Only for everyone else..
+	if (parsed_Line->output_File != NULL){
+		output_Fd = open(parsed_Line->output_File, O_WRONLY|O_TRUNC|O_CREAT|O_CLOEXEC, 0644);
+		if (output_Fd < 0){
+			snprintf(handle->error_Message, MAX_STATUS_CHARACTERS, "smallsh: cannot open %s for output", parsed_Line->output_File);
+			count_Metric(METRIC_REDIRECT_FAILURES);
+			goto fail;
+		}
+	}
+	// an output redirection wins over capturing, there is nothing to capture then
+	else if (launch_Flags & LAUNCH_CAPTURE_OUTPUT){
+		if (pipe2(capture_Pipe, O_CLOEXEC) < 0){
+			snprintf(handle->error_Message, MAX_STATUS_CHARACTERS, "smallsh: pipe() error: %s", strerror(errno));
+			goto fail;
+		}
+	}
+	// built before fork(), the child of a program with threads should not call malloc
+	if (environment == NULL){
+		environment = environ;
+	}
+	if (parsed_Line->assignment_Count > 0){
+		merged_Environment = merge_Environment(environment, parsed_Line->assignments, parsed_Line->assignment_Count);
+		if (merged_Environment == NULL){
+			snprintf(handle->error_Message, MAX_STATUS_CHARACTERS, "smallsh: out of memory building the environment");
+			goto fail;
+		}
+		environment = merged_Environment;
+	}
+	// both ends are closed on exec, so a successful execvp gives the parent end of file
+	if (pipe2(exec_Error_Pipe, O_CLOEXEC) < 0){
+		snprintf(handle->error_Message, MAX_STATUS_CHARACTERS, "smallsh: pipe() error: %s", strerror(errno));
+		goto fail;
+	}
+	// only when we are in the foreground of the terminal ourselves, we must not steal it from somebody else
+	if ((launch_Flags & LAUNCH_NEW_PROCESS_GROUP) && (launch_Flags & LAUNCH_TERMINAL_FOREGROUND)){
+		take_Terminal = isatty(STDIN_FILENO) && tcgetpgrp(STDIN_FILENO) == getpgrp();
+	}
+	// Start the child process for command execution
+	//see lecture https://www.youtube.com/watch?v=EqndHT606Tw
+	handle->pid = fork_Process(&handle->pid_Fd);
+	switch (handle->pid){
+		case -1:
+			snprintf(handle->error_Message, MAX_STATUS_CHARACTERS, "fork()error: %s", strerror(errno));
+			count_Metric(METRIC_FORK_FAILURES);
+			goto fail;
+		case 0:
+			/// CHILD
+			// become the leader of our own process group, the parent does the same from its side
+			//so it does not matter which of us runs first
+			if (launch_Flags & LAUNCH_NEW_PROCESS_GROUP){
+				setpgid(0, 0);
+			}
+			// before the redirections, standard input is still the terminal. The parent does this too,
+			//we must not read the terminal before we own it
+			if (take_Terminal){
+				set_Terminal_Process_Group(getpid());
+			}
+			//int dup2 (int old, int new)---This function copies the descriptor old to descriptor number new.
+			if ((input_Fd >= 0) && (dup2(input_Fd, 0) < 0)){
+				_exit(1);
+			}
+			if ((output_Fd >= 0) && (dup2(output_Fd, 1) < 0)){
+				_exit(1);
+			}
+			if ((capture_Pipe[1] >= 0) && (dup2(capture_Pipe[1], 1) < 0)){
+				_exit(1);
+			}
+			// the originals are not needed once they are copied to 0 and 1
+			if (input_Fd >= 0){
+				close(input_Fd);
+			}
+			if (output_Fd >= 0){
+				close(output_Fd);
+			}
+			if (capture_Pipe[1] >= 0){
+				close(capture_Pipe[1]);
+			}
+			// Foreground commands can be interrupted with ^C, background ones can not
+			//SIG_DFL specifies the default action for the particular signal
+			//SIG_IGN for background commands, a handler the caller installed would be reset by execvp anyway
+			memset(&act, 0, sizeof(act));
+			act.sa_handler = parsed_Line->background ? SIG_IGN : SIG_DFL;
+			sigaction(SIGINT, &act, NULL);
+			//http://stackoverflow.com/questions/14301407/how-does-execvp-run-a-command
+			// execvp passes environ on to the program and searches the PATH in it
+			environ = (char **)environment;
+			execvp(parsed_Line->argv[0], parsed_Line->argv);
+			// only get here if execvp failed, tell the parent why
+			{
+				int exec_Errno = errno;
+				ssize_t ignored = write(exec_Error_Pipe[1], &exec_Errno, sizeof(exec_Errno));
+				(void)ignored;
+			}
+			_exit(1);
+		default:
+			///PARENT
+			break;
+	}
+	free(merged_Environment);
+	if (launch_Flags & LAUNCH_NEW_PROCESS_GROUP){
+		// EACCES here only means the child already exec'd after doing it itself
+		setpgid(handle->pid, handle->pid);
+		handle->process_Group = handle->pid;
+	}
+	if (take_Terminal){
+		set_Terminal_Process_Group(handle->pid);
+	}
+	if (input_Fd >= 0){
+		close(input_Fd);
+	}
+	if (output_Fd >= 0){
+		close(output_Fd);
+	}
+	if (capture_Pipe[1] >= 0){
+		close(capture_Pipe[1]);
+	}
+	handle->capture_Fd = capture_Pipe[0];
+	// only our end, the command keeps a blocking standard output
+	if (handle->capture_Fd >= 0){
+		fcntl(handle->capture_Fd, F_SETFL, fcntl(handle->capture_Fd, F_GETFL) | O_NONBLOCK);
+	}
+	close(exec_Error_Pipe[1]);
+	// read() returns 0 once the child has exec'd, or the errno of the failed execvp
+	while (1){
+		int exec_Errno = 0;
+		ssize_t bytes_Read = read(exec_Error_Pipe[0], &exec_Errno, sizeof(exec_Errno));
+		if (bytes_Read < 0 && errno == EINTR){
+			continue;
+		}
+		if (bytes_Read == sizeof(exec_Errno)){
+			handle->exec_Errno = exec_Errno;
+		}
+		break;
+	}
+	close(exec_Error_Pipe[0]);
+	count_Metric(METRIC_COMMANDS_LAUNCHED);
+	if (handle->exec_Errno != 0){
+		count_Metric(METRIC_EXEC_FAILURES);
+	}
+	observe_Metric(METRIC_SPAWN_SECONDS, metrics_Now() - handle->launch_Time);
+	return 0;
+
+fail:
+	free(merged_Environment);
+	if (input_Fd >= 0){
+		close(input_Fd);
+	}
+	if (output_Fd >= 0){
+		close(output_Fd);
+	}
+	if (capture_Pipe[0] >= 0){
+		close(capture_Pipe[0]);
+		close(capture_Pipe[1]);
+	}
+	if (exec_Error_Pipe[0] >= 0){
+		close(exec_Error_Pipe[0]);
+		close(exec_Error_Pipe[1]);
+	}
+	handle->pid = -1;
+	return -1;
+}
+
+int wait_Command(struct command_Handle *handle){
+	if (wait_Command_Timeout(handle, -1) < 0){
+		return -1;
+	}
+	return 0;
+}
+
+int wait_Command_Timeout(struct command_Handle *handle, int timeout_Milliseconds){
+	long long deadline = milliseconds_Now() + timeout_Milliseconds;
+	struct pollfd poll_Fds[2];
+	// a finished command may still have output from processes it left running, pick up what is there
+	if (handle->finished){
+		if (read_Captured_Output(handle) < 0){
+			return -1;
+		}
+		return 1;
+	}
+	while (1){
+		int poll_Timeout = -1;
+		if (timeout_Milliseconds >= 0){
+			long long remaining = deadline - milliseconds_Now();
+			poll_Timeout = remaining > 0 ? (int)remaining : 0;
+		}
+		// without a pidfd there is nothing to poll for the child, so check on it every 10 milliseconds
+		if ((handle->pid_Fd < 0) && (poll_Timeout < 0 || poll_Timeout > 10)){
+			poll_Timeout = 10;
+		}
+		// poll() skips negative descriptors, so a missing pidfd or capture pipe is fine
+		//we read the output while waiting, a child that fills the pipe would never exit otherwise
+		poll_Fds[0].fd = handle->pid_Fd;
+		poll_Fds[0].events = POLLIN;
+		poll_Fds[0].revents = 0;
+		poll_Fds[1].fd = handle->capture_Fd;
+		poll_Fds[1].events = POLLIN;
+		poll_Fds[1].revents = 0;
+		if (poll(poll_Fds, 2, poll_Timeout) < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			snprintf(handle->error_Message, MAX_STATUS_CHARACTERS, "smallsh: poll() error: %s", strerror(errno));
+			return -1;
+		}
+		if (poll_Fds[1].revents != 0 && read_Captured_Output(handle) < 0){
+			return -1;
+		}
+		if (poll_Fds[0].revents != 0 || handle->pid_Fd < 0){
+			int reaped = reap_Command(handle, WNOHANG);
+			if (reaped < 0){
+				return -1;
+			}
+			if (reaped == 1){
+				// the child is gone, everything it wrote is in the pipe now. We do not wait for end of file,
+				//a background process it started may hold the pipe open for much longer than our timeout
+				if (read_Captured_Output(handle) < 0){
+					return -1;
+				}
+				return 1;
+			}
+		}
+		if ((timeout_Milliseconds >= 0) && (milliseconds_Now() >= deadline)){
+			return 0;
+		}
+	}
+}
+
+int signal_Command(struct command_Handle *handle, int signal_Number){
+	if (handle->finished || handle->pid <= 0){
+		return 0;
+	}
+	if (handle->process_Group > 0){
+		//a negative pid sends the signal to every process in the group
+		return kill(-handle->process_Group, signal_Number);
+	}
+#ifdef SYS_pidfd_send_signal
+	// the pidfd can not point to a different process even if the pid was reused
+	if (handle->pid_Fd >= 0){
+		return (int)syscall(SYS_pidfd_send_signal, handle->pid_Fd, signal_Number, NULL, 0);
+	}
+#endif
+	return kill(handle->pid, signal_Number);
+}
+
+int set_Terminal_Process_Group(pid_t process_Group){
+	sigset_t block_Set;
+	sigset_t previous_Set;
+	int result;
+	// tcsetpgrp() from a background process group sends SIGTTOU to the caller, which would stop it
+	sigemptyset(&block_Set);
+	sigaddset(&block_Set, SIGTTOU);
+	sigprocmask(SIG_BLOCK, &block_Set, &previous_Set);
+	result = tcsetpgrp(STDIN_FILENO, process_Group);
+	sigprocmask(SIG_SETMASK, &previous_Set, NULL);
+	return result;
+}
+
+int poll_Command(struct command_Handle *handle){
+	return wait_Command_Timeout(handle, 0);
+}
+
+void release_Command(struct command_Handle *handle){
+	if (handle->capture_Fd >= 0){
+		close(handle->capture_Fd);
+		handle->capture_Fd = -1;
+	}
+	if (handle->pid_Fd >= 0){
+		close(handle->pid_Fd);
+		handle->pid_Fd = -1;
+	}
+	free(handle->captured_Output);
+	handle->captured_Output = NULL;
+	handle->captured_Length = 0;
+	handle->captured_Capacity = 0;
+}
+
+int run_Command_Line(const char *input_Command, int launch_Flags, struct command_Handle *handle){
+	struct parsed_Command parsed_Line;
+	if (parse_Command_Line(input_Command, &parsed_Line) < 0){
+		memset(handle, 0, sizeof(*handle));
+		handle->pid = -1;
+		handle->pid_Fd = -1;
+		handle->capture_Fd = -1;
+		snprintf(handle->error_Message, MAX_STATUS_CHARACTERS, "%s", parsed_Line.error_Message);
+		return -1;
+	}
+	if (launch_Command(&parsed_Line, launch_Flags, handle) < 0){
+		return -1;
+	}
+	if (parsed_Line.background){
+		return 0;
+	}
+	return wait_Command(handle);
+}
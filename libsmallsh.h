@@ -0,0 +1,198 @@
+/*********************************************************************************************************
+* Tatyana Vlaskin (vlaskint@onid.oregonstate.edu)
+* OregonState EECS
+* Filename: libsmallsh.h
+*
+* Description: Embeddable core of smallsh. The parsing and launching logic that used to live inside
+* smallsh.c is kept here so that other C/C++ programs can run smallsh command lines directly, without
+* going through system() or popen() and an extra /bin/sh process.
+* 1. parse_Command_Line() breaks a line of the form command [arg1 arg2 ...] [< input_file] [> output_file] [&]
+*    into a struct parsed_Command
+* 2. launch_Command() forks and execs the parsed command with its redirections and fills a struct command_Handle
+* 3. wait_Command() blocks until the command is done, wait_Command_Timeout() gives up after a number of
+*    milliseconds and poll_Command() checks without blocking. Children are tracked with a pidfd made together
+*    with the child, so we never wait for or signal another process that reused its pid. A waitpid(-1) elsewhere
+*    in the program can still reap our child, waiting for it then fails.
+* 4. signal_Command() sends a signal to the command, or to its whole process group if it has its own
+* 5. when the command is done the handle holds the exit value, the terminating signal, the rusage of the
+*    child and (if LAUNCH_CAPTURE_OUTPUT was requested) everything the command wrote to its standard output
+* 6. run_Command_Line() is the one call replacement for system(): parse, launch and wait
+* 7. parsing, launching and reaping update the counters and histograms in metrics.h
+* 8. NAME=value words in front of a command only go to the environment of that command,
+*    launch_Command_Environment() takes the environment to start from (see variables.h)
+* Functions return -1 on failure, error_Message of the parsed command or the handle then explains what went wrong
+* (signal_Command() and set_Terminal_Process_Group() set errno instead). On success most return 0, but
+* wait_Command_Timeout() and poll_Command() return 1 when the command is done and 0 when it is still running,
+* and release_Command() returns nothing. See each function below.
+******************************************************************************************************************/
+#ifndef LIBSMALLSH_H
+#define LIBSMALLSH_H
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define MAX_ARGUMENTS 512
+#define MAX_CHARACTERS 2048
+#define MAX_STATUS_CHARACTERS 2048
+#define MAX_ASSIGNMENTS 128
+
+// flags for launch_Command() and run_Command_Line()
+#define LAUNCH_CAPTURE_OUTPUT 1 // collect the standard output of the command in the handle instead of sharing ours
+#define LAUNCH_NEW_PROCESS_GROUP 2 // put the command in a process group of its own so it can be signalled as a whole
+#define LAUNCH_TERMINAL_FOREGROUND 4 // with LAUNCH_NEW_PROCESS_GROUP, make that group the foreground group of our terminal
+
+/*************************************************************************************************************
+ * Structure: struct parsed_Command
+ * Description: One command line broken into words. The words live in line_Buffer, so the argv pointers
+ * stay valid for as long as the structure itself does.
+ * assignments are the NAME=value words in front of the command, they only go to the environment of
+ * that command. Both argv and assignments are NULL terminated.
+ * input_File and output_File are NULL when there is no < or > redirection.
+ * background is 1 when the command line ended with the & word.
+ ***************************************************************************************************************/
+struct parsed_Command {
+	char line_Buffer[MAX_CHARACTERS];
+	char *argv[MAX_ARGUMENTS];
+	int argument_Count;
+	char *assignments[MAX_ASSIGNMENTS];
+	int assignment_Count;
+	char *input_File;
+	char *output_File;
+	int background;
+	char error_Message[MAX_STATUS_CHARACTERS];
+};
+
+/*************************************************************************************************************
+ * Structure: struct command_Handle
+ * Description: A launched command. finished becomes 1 once wait_Command() or poll_Command() has reaped
+ * the child, after that exit_Value (-1 if killed), signal_Number (0 if exited normally), wait_Status and
+ * usage describe how it ended.
+ * exec_Errno is not 0 when the child could not exec the program, the child then exits with value 1.
+ * pid_Fd is the pidfd of the child, -1 if the kernel does not have pidfds (we then poll with wait4 on the pid).
+ * process_Group is the process group id of the command when LAUNCH_NEW_PROCESS_GROUP was used, 0 otherwise.
+ * launch_Time is the metrics_Now() time stamp of the launch, used for the command wall time.
+ * background is 1 for a command that ended with &. Those are usually reaped long after they are done,
+ * so they are left out of the command wall time.
+ * captured_Output is a NUL terminated buffer of captured_Length bytes when LAUNCH_CAPTURE_OUTPUT was used.
+ * It has all the output of the command once it is done. Processes the command left running may keep
+ * writing, capture_Fd stays open until they close it and later poll_Command() calls add their output.
+ ***************************************************************************************************************/
+struct command_Handle {
+	pid_t pid;
+	int pid_Fd;
+	pid_t process_Group;
+	int finished;
+	int exit_Value;
+	int signal_Number;
+	int wait_Status;
+	int exec_Errno;
+	long long launch_Time;
+	int background;
+	struct rusage usage;
+	int capture_Fd;
+	char *captured_Output;
+	size_t captured_Length;
+	size_t captured_Capacity;
+	char error_Message[MAX_STATUS_CHARACTERS];
+};
+
+ /*************************************************************************************************************
+ * Function:  int parse_Command_Line(const char *input_Command, struct parsed_Command *parsed_Line)
+ * Description: Function breaks the users input into words separated by white space. NAME=value words
+ * in front of the command are assignments. The words before
+ * the first <, > or & are the arguments, the word after < or > is the file name for that redirection
+ * and a & word marks a background command. The input string is not modified.
+ * Parameters: command line and the structure that will store the result
+ * returns 0 - if the line was parsed, the line may still have zero arguments (blank line)
+ * returns -1 - if the line is too long, has too many arguments or a redirection without a file name
+ ***************************************************************************************************************/
+int parse_Command_Line(const char *input_Command, struct parsed_Command *parsed_Line);
+
+ /*************************************************************************************************************
+ * Function:  int launch_Command(const struct parsed_Command *parsed_Line, int launch_Flags, struct command_Handle *handle)
+ * Description: Function opens the redirection files, forks and execs the parsed command.
+ * A background command without an input redirection reads from /dev/null. Foreground commands
+ * get the default SIGINT action back, background commands ignore SIGINT like they do in sh without job control.
+ * With LAUNCH_NEW_PROCESS_GROUP the child becomes the leader of a new process group.
+ * With LAUNCH_TERMINAL_FOREGROUND as well, and our standard input a terminal, the new group is made the foreground
+ * group of that terminal, so the command can read it and ^C and ^Z reach it. The caller takes the terminal back
+ * with set_Terminal_Process_Group(getpgrp()) once the command is done.
+ * Parameters: parsed command, LAUNCH_* flags and the handle that will describe the running command
+ * returns 0 - if the child was started (check exec_Errno to see if the program was found)
+ * returns -1 - if a redirection file could not be opened or fork() failed, nothing is running then
+ ***************************************************************************************************************/
+int launch_Command(const struct parsed_Command *parsed_Line, int launch_Flags, struct command_Handle *handle);
+
+ /*************************************************************************************************************
+ * Function:  int launch_Command_Environment(const struct parsed_Command *parsed_Line, int launch_Flags,
+ *                                           char *const *environment, struct command_Handle *handle)
+ * Description: Function is launch_Command() with the environment for the command given as an array of
+ * NAME=value strings, for example from variable_Environment() in variables.h. NULL means our own environ.
+ * The assignments of the command line are added on top of it.
+ ***************************************************************************************************************/
+int launch_Command_Environment(const struct parsed_Command *parsed_Line, int launch_Flags, char *const *environment, struct command_Handle *handle);
+
+ /*************************************************************************************************************
+ * Function:  int wait_Command(struct command_Handle *handle)
+ * Description: Function blocks until the command is done, reading any captured output on the way
+ * Parameters: handle filled by launch_Command()
+ * returns 0 - the command is done and the handle has its results
+ * returns -1 - the child could not be waited for (for example somebody else already reaped it)
+ ***************************************************************************************************************/
+int wait_Command(struct command_Handle *handle);
+
+ /*************************************************************************************************************
+ * Function:  int wait_Command_Timeout(struct command_Handle *handle, int timeout_Milliseconds)
+ * Description: Function waits with poll() on the pidfd and the capture pipe until the command is done
+ * or the timeout expires. The command keeps running after a timeout, use signal_Command() to stop it.
+ * It never waits for the capture pipe to be closed by processes the command left running.
+ * Parameters: handle filled by launch_Command() and the timeout, -1 waits forever
+ * returns 1 - the command is done, returns 0 - timed out, returns -1 - error
+ ***************************************************************************************************************/
+int wait_Command_Timeout(struct command_Handle *handle, int timeout_Milliseconds);
+
+ /*************************************************************************************************************
+ * Function:  int signal_Command(struct command_Handle *handle, int signal_Number)
+ * Description: Function sends a signal to the process group of the command if it has one, to the command
+ * itself otherwise. A command that was already reaped is not signalled.
+ * Parameters: handle filled by launch_Command() and the signal to send
+ * returns 0 - on success, returns -1 - if the signal could not be sent
+ ***************************************************************************************************************/
+int signal_Command(struct command_Handle *handle, int signal_Number);
+
+ /*************************************************************************************************************
+ * Function:  int set_Terminal_Process_Group(pid_t process_Group)
+ * Description: Function makes process_Group the foreground process group of the terminal on our standard input.
+ * SIGTTOU is blocked meanwhile, so a shell that is in the background of the terminal can take it back.
+ * Parameters: process group id
+ * returns 0 - on success, returns -1 - if standard input is not a terminal or tcsetpgrp() failed
+ ***************************************************************************************************************/
+int set_Terminal_Process_Group(pid_t process_Group);
+
+ /*************************************************************************************************************
+ * Function:  int poll_Command(struct command_Handle *handle)
+ * Description: Function checks if the command is done without blocking, reading the captured output that
+ * is already available
+ * Parameters: handle filled by launch_Command()
+ * returns 1 - the command is done, returns 0 - still running, returns -1 - error
+ ***************************************************************************************************************/
+int poll_Command(struct command_Handle *handle);
+
+ /*************************************************************************************************************
+ * Function:  void release_Command(struct command_Handle *handle)
+ * Description: Function frees the captured output and closes the capture pipe and the pidfd. It does not kill or
+ * reap a command that is still running.
+ * Parameters: handle filled by launch_Command()
+ ***************************************************************************************************************/
+void release_Command(struct command_Handle *handle);
+
+ /*************************************************************************************************************
+ * Function:  int run_Command_Line(const char *input_Command, int launch_Flags, struct command_Handle *handle)
+ * Description: Function parses and launches a command line, and waits for it unless it ends with &
+ * Parameters: command line, LAUNCH_* flags and the handle that will describe the command
+ * returns 0 - on success, returns -1 - on parse, launch or wait failure (see handle->error_Message)
+ ***************************************************************************************************************/
+int run_Command_Line(const char *input_Command, int launch_Flags, struct command_Handle *handle);
+
+#endif
@@ -0,0 +1,178 @@
+/*********************************************************************************************************
+* Tatyana Vlaskin (vlaskint@onid.oregonstate.edu)
+* OregonState EECS
+* Filename: metrics.c
+*
+* Description: Counters and latency histograms, see metrics.h for the interface.
+* Everything is a statically allocated atomic that is only ever updated with a relaxed fetch and add,
+* so updating a metric costs about as much as an increment and never waits for anything.
+* http://en.cppreference.com/w/c/atomic/atomic_fetch_add
+******************************************************************************************************************/
+#include <stdio.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+// upper bounds of the histogram buckets in nanoseconds, the last bucket is +Inf
+#define METRIC_BUCKETS 16
+static const long long bucket_Bounds[METRIC_BUCKETS - 1] = {
+	10000LL, 50000LL, 100000LL, 250000LL, 500000LL,
+	1000000LL, 2500000LL, 5000000LL, 10000000LL, 50000000LL,
+	100000000LL, 500000000LL, 1000000000LL, 10000000000LL, 60000000000LL
+};
+
+static const char *metric_Counter_Names[METRIC_COUNTERS][2] = {
+	{"smallsh_commands_launched_total", "Commands started with fork and exec."},
+	{"smallsh_fork_failures_total", "Commands that could not be started because fork() failed."},
+	{"smallsh_exec_failures_total", "Commands whose program could not be executed."},
+	{"smallsh_redirect_failures_total", "Commands whose redirection file could not be opened."},
+	{"smallsh_commands_signaled_total", "Commands that were terminated by a signal."},
+	{"smallsh_commands_timed_out_total", "Commands stopped by the timeout built in command."}
+};
+
+static const char *metric_Histogram_Names[METRIC_HISTOGRAMS][2] = {
+	{"smallsh_spawn_seconds", "Time from launching a command until it has executed its program."},
+	{"smallsh_command_seconds", "Wall time of foreground commands from launch until they are reaped."},
+	{"smallsh_parse_seconds", "Time spent parsing command lines."}
+};
+
+static atomic_ullong metric_Counters[METRIC_COUNTERS];
+static atomic_ullong metric_Signals[METRIC_MAX_SIGNAL + 1];
+static atomic_ullong metric_Buckets[METRIC_HISTOGRAMS][METRIC_BUCKETS];
+static atomic_ullong metric_Sums[METRIC_HISTOGRAMS];
+static atomic_int metric_Background_Jobs;
+
+long long metrics_Now(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void count_Metric(int counter){
+	atomic_fetch_add_explicit(&metric_Counters[counter], 1, memory_order_relaxed);
+}
+
+void count_Signal_Metric(int signal_Number){
+	if (signal_Number > 0 && signal_Number <= METRIC_MAX_SIGNAL){
+		atomic_fetch_add_explicit(&metric_Signals[signal_Number], 1, memory_order_relaxed);
+	}
+}
+
+void observe_Metric(int histogram, long long nanoseconds){
+	int bucket = 0;
+	if (nanoseconds < 0){
+		nanoseconds = 0;
+	}
+	// the buckets are few and sorted, a linear search is as fast as anything else here
+	while (bucket < METRIC_BUCKETS - 1 && nanoseconds > bucket_Bounds[bucket]){
+		bucket++;
+	}
+	atomic_fetch_add_explicit(&metric_Buckets[histogram][bucket], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&metric_Sums[histogram], (unsigned long long)nanoseconds, memory_order_relaxed);
+}
+
+void set_Background_Jobs_Metric(int background_Jobs){
+	atomic_store_explicit(&metric_Background_Jobs, background_Jobs, memory_order_relaxed);
+}
+
+size_t format_Metrics(char *buffer, size_t buffer_Size){
+	size_t length = 0;
+	int i;
+	int bucket;
+	// snprintf returns how much it wanted to write, stop adding once the buffer is full
+#define APPEND_METRIC(...) do { \
+		if (length < buffer_Size){ \
+			int written = snprintf(buffer + length, buffer_Size - length, __VA_ARGS__); \
+			if (written > 0){ \
+				length += (size_t)written; \
+			} \
+		} \
+	} while (0)
+	if (buffer_Size > 0){
+		buffer[0] = '\0';
+	}
+	for (i = 0; i < METRIC_COUNTERS; i++){
+		APPEND_METRIC("# HELP %s %s\n# TYPE %s counter\n%s %llu\n",
+		              metric_Counter_Names[i][0], metric_Counter_Names[i][1], metric_Counter_Names[i][0],
+		              metric_Counter_Names[i][0], atomic_load_explicit(&metric_Counters[i], memory_order_relaxed));
+	}
+	APPEND_METRIC("# HELP smallsh_signals_received_total Signals received by the shell.\n"
+	              "# TYPE smallsh_signals_received_total counter\n");
+	for (i = 1; i <= METRIC_MAX_SIGNAL; i++){
+		unsigned long long received = atomic_load_explicit(&metric_Signals[i], memory_order_relaxed);
+		if (received != 0){
+			APPEND_METRIC("smallsh_signals_received_total{signal=\"%d\"} %llu\n", i, received);
+		}
+	}
+	APPEND_METRIC("# HELP smallsh_background_jobs Background commands that are still running.\n"
+	              "# TYPE smallsh_background_jobs gauge\nsmallsh_background_jobs %d\n",
+	              atomic_load_explicit(&metric_Background_Jobs, memory_order_relaxed));
+	for (i = 0; i < METRIC_HISTOGRAMS; i++){
+		const char *name = metric_Histogram_Names[i][0];
+		unsigned long long cumulative = 0;
+		APPEND_METRIC("# HELP %s %s\n# TYPE %s histogram\n", name, metric_Histogram_Names[i][1], name);
+		// Prometheus buckets count everything less than or equal to their bound, so they add up
+		for (bucket = 0; bucket < METRIC_BUCKETS; bucket++){
+			cumulative += atomic_load_explicit(&metric_Buckets[i][bucket], memory_order_relaxed);
+			if (bucket < METRIC_BUCKETS - 1){
+				APPEND_METRIC("%s_bucket{le=\"%g\"} %llu\n", name, bucket_Bounds[bucket] / 1e9, cumulative);
+			}
+			else{
+				APPEND_METRIC("%s_bucket{le=\"+Inf\"} %llu\n", name, cumulative);
+			}
+		}
+		APPEND_METRIC("%s_sum %.9f\n%s_count %llu\n", name,
+		              atomic_load_explicit(&metric_Sums[i], memory_order_relaxed) / 1e9, name, cumulative);
+	}
+#undef APPEND_METRIC
+	if (length >= buffer_Size){
+		length = buffer_Size > 0 ? buffer_Size - 1 : 0;
+	}
+	return length;
+}
+
+int write_Metrics_File(const char *file_Path){
+	// static so writing the file does not need a 16KB stack frame or an allocation
+	static char metrics_Text[METRICS_TEXT_SIZE];
+	char temporary_Path[4096];
+	size_t length = format_Metrics(metrics_Text, sizeof(metrics_Text));
+	size_t written = 0;
+	int fd;
+	if (snprintf(temporary_Path, sizeof(temporary_Path), "%s.%d.tmp", file_Path, (int)getpid()) >= (int)sizeof(temporary_Path)){
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	fd = open(temporary_Path, O_WRONLY|O_TRUNC|O_CREAT|O_CLOEXEC, 0644);
+	if (fd < 0){
+		return -1;
+	}
+	while (written < length){
+		ssize_t bytes_Written = write(fd, metrics_Text + written, length - written);
+		if (bytes_Written < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			close(fd);
+			unlink(temporary_Path);
+			return -1;
+		}
+		written += (size_t)bytes_Written;
+	}
+	if (close(fd) < 0){
+		unlink(temporary_Path);
+		return -1;
+	}
+	// rename() replaces the old file in one step, readers see either the old or the new metrics
+	if (rename(temporary_Path, file_Path) < 0){
+		int rename_Errno = errno;
+		unlink(temporary_Path);
+		errno = rename_Errno;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,87 @@
+/*********************************************************************************************************
+* Tatyana Vlaskin (vlaskint@onid.oregonstate.edu)
+* OregonState EECS
+* Filename: metrics.h
+*
+* Description: In process counters and latency histograms for smallsh and libsmallsh.
+* 1. the counters and histograms are fixed size arrays of atomics, updating them never allocates or locks,
+*    so they can be updated on every command and from signal handlers
+* 2. histograms have the fixed buckets listed in metrics.c, times are recorded in nanoseconds
+* 3. format_Metrics() writes everything in the Prometheus text format, write_Metrics_File() does that
+*    to a temporary file and renames it over the real one, so a reader never sees a half written file
+*    https://prometheus.io/docs/instrumenting/exposition_formats/
+******************************************************************************************************************/
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+
+// counters, see metric_Counter_Names in metrics.c for the exported names
+#define METRIC_COMMANDS_LAUNCHED 0
+#define METRIC_FORK_FAILURES 1
+#define METRIC_EXEC_FAILURES 2
+#define METRIC_REDIRECT_FAILURES 3
+#define METRIC_COMMANDS_SIGNALED 4
+#define METRIC_COMMANDS_TIMED_OUT 5
+#define METRIC_COUNTERS 6
+
+// histograms
+#define METRIC_SPAWN_SECONDS 0   // from launch_Command() until the child has exec'd
+#define METRIC_COMMAND_SECONDS 1 // from launch_Command() until the child is reaped, foreground commands only
+#define METRIC_PARSE_SECONDS 2   // parse_Command_Line()
+#define METRIC_HISTOGRAMS 3
+
+#define METRIC_MAX_SIGNAL 64
+
+ /*************************************************************************************************************
+ * Function:  long long metrics_Now(void)
+ * Description: Function returns a monotonic time stamp in nanoseconds for measuring latencies
+ ***************************************************************************************************************/
+long long metrics_Now(void);
+
+ /*************************************************************************************************************
+ * Function:  void count_Metric(int counter)
+ * Description: Function adds one to a counter
+ * Parameters: one of the METRIC_* counter numbers
+ ***************************************************************************************************************/
+void count_Metric(int counter);
+
+ /*************************************************************************************************************
+ * Function:  void count_Signal_Metric(int signal_Number)
+ * Description: Function adds one to the count of a signal received by the shell. Safe in a signal handler.
+ * Parameters: signal number
+ ***************************************************************************************************************/
+void count_Signal_Metric(int signal_Number);
+
+ /*************************************************************************************************************
+ * Function:  void observe_Metric(int histogram, long long nanoseconds)
+ * Description: Function records one latency in a histogram
+ * Parameters: one of the METRIC_* histogram numbers and the latency in nanoseconds
+ ***************************************************************************************************************/
+void observe_Metric(int histogram, long long nanoseconds);
+
+ /*************************************************************************************************************
+ * Function:  void set_Background_Jobs_Metric(int background_Jobs)
+ * Description: Function sets the gauge of background commands that are still running
+ * Parameters: number of background commands
+ ***************************************************************************************************************/
+void set_Background_Jobs_Metric(int background_Jobs);
+
+ /*************************************************************************************************************
+ * Function:  size_t format_Metrics(char *buffer, size_t buffer_Size)
+ * Description: Function writes all the metrics into the buffer in the Prometheus text format
+ * Parameters: buffer and its size, METRICS_TEXT_SIZE is always big enough
+ * returns the length of the text, the text is cut short if the buffer is too small
+ ***************************************************************************************************************/
+#define METRICS_TEXT_SIZE 16384
+size_t format_Metrics(char *buffer, size_t buffer_Size);
+
+ /*************************************************************************************************************
+ * Function:  int write_Metrics_File(const char *file_Path)
+ * Description: Function writes the metrics to file_Path.PID.tmp and renames it to file_Path
+ * Parameters: path of the Prometheus textfile, for example for the node_exporter textfile collector
+ * returns 0 - on success, returns -1 - if the file could not be written (errno is set)
+ ***************************************************************************************************************/
+int write_Metrics_File(const char *file_Path);
+
+#endif
@@ -14,7 +14,12 @@
 * 8. If standard input or output is to be redirected, the > or < words followed by a filename word must appear after all the arguments.  Input redirection can appear before or after output redirection.
 * 9. Shell support command lines with a maximum length of 2048 characters, and a maximum of 512 arguments.
 *10. Shell does not  support any quoting; so arguments with spaces inside them are not possible.
-*11. There is no error checking on the syntax of the command line.
+*11. There is no error checking on the syntax of the command line.
+*12. timeout DURATION [--kill-after D] command [arg1 arg2 ...] runs a command with a time limit, like coreutils timeout.
+*13. stats shows the counters and latency histograms of the shell, SMALLSH_METRICS_FILE also writes them to a file.
+*14. export [NAME[=value] ...] sets and exports variables, without names it lists the exported ones.
+*15. unset NAME ... removes variables.
+*16. NAME=value on its own sets a shell variable, NAME=value command [arg1 ...] only sets it for that command.
 * Motivation: This program is an assignment for the
 * operating systems course at OSU. The goal is to create
 * an interactive shell with basic functionality in the C
@@ -25,93 +30,175 @@
 * and see other sources in the code comments
 ******************************************************************************************************************/
 #include <stdio.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <termios.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
+#include <poll.h>
 #include <sys/types.h>
+#include <sys/select.h>
+#include <limits.h>
+#include <math.h>
 
-#define MAX_ARGUMENTS 512
-#define MAX_CHARACTERS 2048
-#define MAX_STATUS_CHARACTERS 2048
-
- /*************************************************************************************************************
- * Function:  int substring_Finder(char *search_String, char *substering_Of_Interst)
- * Description: Function to search for a specific substring in a string
- * Parameters: sting and substring
- * returns 1 - if substring was found
- * returns 2 - if substring was not founf\d
- * taken from http://articles.leetcode.com/2010/10/implement-strstr-to-find-substring-in.html
- ***************************************************************************************************************/
-int substring_Finder(char *search_String, char *substering_Of_Interst);
+#include "libsmallsh.h"
+#include "metrics.h"
+#include "variables.h"
 
- /*************************************************************************************************************
- * Function:  void file_Name(char *input_Command, char *file_Name_Entered)
- * Description: Function that takes a user entered command and returns a file name
- * that the user entered in case there is a redirection
- * we use user defined helper function: (substring_Finder(string, substring),to check if the entered command
- * has < or > substrings
- * Parameters: users command and variable that will store the file name
- ***************************************************************************************************************/
-void file_Name(char *input_Command, char *file_Name_Entered);
-
-/*************************************************************************************************************
- * Function:  void split_Users_Command_into_Arguments(char *input_Command, char **command_Arguments)
- * Description: Function break users input into individual words and stores those words in the array
- * The function also checks for the presence of the <, >, and $ charactesr and does not include
- * them in the array. The function uses strtok() C function and uses white space as a delimiter.
- * code adopted from  http://codereview.stackexchange.com/questions/42990/tokenizing-string-using-strtok
- * http://faq.cprogramming.com/cgi-bin/smartfaq.cgi?answer=1061423302&id=1044780608
- ***************************************************************************************************************/
-void split_Users_Command_into_Arguments(char *input_Command, char **command_Arguments);
+// the environment we were started with, imported into shell_Variables
+extern char **environ;
 
  /******************************************************************************************************************
- * Function:  int foreground_Command(char *input_Command, char *status_Message)
+ * Function:  int foreground_Command(struct parsed_Command *parsed_Line, char *status_Message,
+ *                                    int timeout_Milliseconds, int kill_After_Milliseconds)
  * Description: Function that will run specified foreground command
- * Function will return 0 if the command executed without any error.
- * Parameters: command that the user have entered and that does NOT have an & sign
+ * Function will return the exit value of the command.
+ * Parameters: command that the user have entered and that does NOT have an & sign,
+ * the time limit and the extra time before SIGKILL in milliseconds, -1 for no limit
  *  *  ***************************************************************************************************************/
-int foreground_Command(char *input_Command, char *status_Message);
+int foreground_Command(struct parsed_Command *parsed_Line, char *status_Message, int timeout_Milliseconds, int kill_After_Milliseconds);
 
  /***************************************************************************************************************
- * Function:  int background_Command(char *input_Command)
+ * Function:  int background_Command(struct parsed_Command *parsed_Line)
  * Description: Function that will run specified background command
- * Function will return 0 if the command executed without any error.
+ * Function will return 0 if the command was started without any error.
  * Parameters: command that the user have entered and that has an & sign
  *  ***************************************************************************************************************/
-int background_Command(char *input_Command);
+int background_Command(struct parsed_Command *parsed_Line);
 
  /*************************************************************************************************************
- * Function:  static void signal_Child_Handler (int sig){
- * Description: Function that will monitor the child signals(when SIGCHLD signal is received by parent) and
- * determining which termination method or completion exit value to display. This is the void handler function for the
- *
- *       struct sigaction {
- *              void     (*sa_handler)(int);
- *              void     (*sa_sigaction)(int, siginfo_t *, void *);
- *              sigset_t   sa_mask;
- *              int        sa_flags;
- *              void     (*sa_restorer)(void);
- *          };
- * this function is required for int sigaction(int signum, const struct sigaction *act, struct sigaction *oldact)
- * function, which will be used in the main function to change actions taken by a process on receipts of specific signal
- * Function will return 0 if the command executed without any error.
- *  function adopted from https://github.com/swanyriver/small-shell/blob/master/prepare.c
- * https://github.com/ianks/shell-lab/blob/master/tsh.cc
- * http://man7.org/tlpi/code/online/diff/procexec/multi_SIGCHLD.c.html
- * http://www.linuxprogrammingblog.com/code-examples/SIGCHLD-handler
- * https://www.youtube.com/watch?v=ls5cGi12kGw
- * https://github.com/mptcp-nexus/android_system_netd/blob/master/main.cpp
- * http://openverse.com/~andy/devel/old/eat/src/pty.c
- * http://www.cs.rit.edu/usr/local/pub/wrc/courses/sp1/textbooks/tlpi-dist/procexec/multi_SIGCHLD.c
- * https://www.youtube.com/watch?v=M-qtkcLQJG0
- * https://github.com/esmil/lem/blob/master/lem/signal/core.c
- * ***************************************************************************************************************/
-static void signal_Child_Handler (int sig);
+ * Function:  static void check_Background_Jobs(void)
+ * Description: Function checks if any background processes completed and prints their process id and
+ * exit status. It is called just before we prompt for a new command. Every background command is tracked
+ * by the pidfd in its handle and reaped through it, so a foreground command is never reaped here and
+ * a background command is never reaped by the foreground wait.
+ ***************************************************************************************************************/
+static void check_Background_Jobs(void);
+
+ /*************************************************************************************************************
+ * Function:  int timeout_Command(struct parsed_Command *parsed_Line, char *status_Message)
+ * Description: Built in command timeout DURATION [--kill-after D] command [arg1 arg2 ...]
+ * Runs the command in the foreground in a process group of its own, that group gets the terminal while it runs
+ * (like timeout --foreground) if smallsh has one. If it is still running after DURATION
+ * the whole group gets SIGTERM, and if --kill-after was given and it is still running D later, SIGKILL.
+ * DURATION and D are numbers with an optional s, m, h or d suffix, 0 means no limit.
+ * Function will return 124 if the command timed out, 137 if it had to be killed, 125 if timeout itself
+ * failed and the exit value of the command otherwise (same as the coreutils timeout command).
+ * Parameters: parsed command line starting with the word timeout and the status message
+ ***************************************************************************************************************/
+int timeout_Command(struct parsed_Command *parsed_Line, char *status_Message);
+
+ /*************************************************************************************************************
+ * Function:  static void forward_Interrupt_Handler(int sig)
+ * Description: Function passes ^C on to the process group of a timed foreground command. Without a terminal
+ * (or when smallsh is not in its foreground) that group does not get SIGINT from the terminal.
+ ***************************************************************************************************************/
+static void forward_Interrupt_Handler(int sig);
+
+ /*************************************************************************************************************
+ * Function:  int variable_Command(struct parsed_Command *parsed_Line)
+ * Description: Built in commands for variables
+ * export                     shows the exported variables
+ * export NAME[=value] ...    sets and exports variables, the commands we launch get them in their environment
+ * unset NAME ...             removes variables
+ * NAME=value ...             with no command sets shell variables, they are only exported after export NAME
+ * Function will return 0 on success and 1 if a name was not valid.
+ * Parameters: parsed command line
+ ***************************************************************************************************************/
+int variable_Command(struct parsed_Command *parsed_Line);
+
+ /*************************************************************************************************************
+ * Function:  static void report_Line_Status(int status_Exit_Value)
+ * Description: Function writes "exit_value signal" and a new line to SMALLSH_STATUS_FD once an input line
+ * is done. smallsh_replay uses this to know when a line is finished and how it ended without having to
+ * send extra status commands. Our standard output is flushed first, so everything the line printed is
+ * already in the pipe when the status arrives.
+ ***************************************************************************************************************/
+static void report_Line_Status(int status_Exit_Value);
+
+ /*************************************************************************************************************
+ * Function:  static void count_Signal_Handler(int sig)
+ * Description: Function counts the signals the shell receives for the metrics. SIGINT is otherwise ignored
+ * like before, SIGTERM and SIGHUP ask the shell to exit after the current command.
+ ***************************************************************************************************************/
+static void count_Signal_Handler(int sig);
+
+ /*************************************************************************************************************
+ * Function:  static void exit_If_Terminated(void)
+ * Description: Function exits with 128 + the signal number if SIGTERM or SIGHUP arrived, exit() writes the metrics.
+ * It is called before every prompt, so a signal that came while a command was running is acted on once it is
+ * done, and again after reading a line, which the signal interrupts.
+ ***************************************************************************************************************/
+static void exit_If_Terminated(void);
+
+ /*************************************************************************************************************
+ * Function:  static void write_Metrics(int only_If_Due)
+ * Description: Function writes the metrics to the file named by the SMALLSH_METRICS_FILE environment
+ * variable, if there is one. With only_If_Due it only writes when SMALLSH_METRICS_INTERVAL seconds
+ * (15 by default) have passed since the last write. It is called before every prompt, while we wait for input
+ * or for a foreground command (see wait_For_Input() and wait_Foreground_Command()) and when we exit.
+ ***************************************************************************************************************/
+static void write_Metrics(int only_If_Due);
+static void write_Metrics_At_Exit(void);
+
+ /*************************************************************************************************************
+ * Function:  static int milliseconds_Until_Metrics(void)
+ * Description: Function returns how long we may wait before the metrics file is due, -1 if there is no file
+ ***************************************************************************************************************/
+static int milliseconds_Until_Metrics(void);
+
+ /*************************************************************************************************************
+ * Function:  static void wait_For_Input(void)
+ * Description: Function waits until standard input can be read, writing the metrics file whenever it is due,
+ * so an idle shell keeps its metrics fresh. SIGTERM and SIGHUP are only let in while pselect() waits, so one
+ * can not slip in between our check of terminate_Signal and the wait.
+ ***************************************************************************************************************/
+static void wait_For_Input(void);
+
+ /*************************************************************************************************************
+ * Function:  static int read_Input_Line(char *line, size_t line_Size)
+ * Description: Function reads one line from descriptor 0 into line, without the new line character.
+ * We read through our own buffer instead of stdio, so wait_For_Input() can see if the next line is already here.
+ * A line that does not fit is read to its end and thrown away, a line of line_Size - 1 characters still fits.
+ * Parameters: buffer for the line and its size
+ * returns 1 - a line was read, returns 0 - end of input, returns -1 - the line was too long
+ ***************************************************************************************************************/
+static int read_Input_Line(char *line, size_t line_Size);
+
+ /*************************************************************************************************************
+ * Function:  static int wait_Foreground_Command(struct command_Handle *handle, int timeout_Milliseconds)
+ * Description: Function is wait_Command_Timeout() in slices no longer than the metrics interval, writing the
+ * metrics file between them, so a long running command does not stop the metrics
+ ***************************************************************************************************************/
+static int wait_Foreground_Command(struct command_Handle *handle, int timeout_Milliseconds);
+
+#define MAX_BACKGROUND_JOBS 512
+
+// background commands that have not been reported as done yet
+static struct command_Handle background_Jobs[MAX_BACKGROUND_JOBS];
+static int background_Job_Count = 0;
+// process group of the timed foreground command, 0 when there is none
+static volatile sig_atomic_t foreground_Process_Group = 0;
+// set by SIGTERM or SIGHUP, the shell exits with 128 + this signal number
+static volatile sig_atomic_t terminate_Signal = 0;
+// Prometheus textfile, NULL when metrics are only shown by the stats command
+static const char *metrics_File_Path = NULL;
+static long long metrics_Interval = 15000000000LL;
+static long long last_Metrics_Write = 0;
+// shell and environment variables, the exported ones are the environment of every command we launch
+static struct variable_Store shell_Variables;
+// signal that terminated the last foreground command, 0 if it exited normally
+static int foreground_Signal_Number = 0;
+// SMALLSH_STATUS_FD, where we report "exit_value signal" after every input line for smallsh_replay, -1 for none
+static int status_Report_Fd = -1;
+// input read from descriptor 0 that read_Input_Line() has not handed out yet, and whether we saw end of file
+static char input_Buffer[4096];
+static size_t input_Start = 0;
+static size_t input_End = 0;
+static int input_At_End = 0;
 
 
 /******************************************************************************************************************
@@ -119,29 +206,58 @@ MAIN FUNCTION
  * ****************************************************************************************************************/
 int main(){
     int exit_Shell_Request = 0; // 0-run shell, 1-exit shell
+	int line_Was_Read = 0; // 1 once we have an input line to report to SMALLSH_STATUS_FD
+	int read_Result; // what read_Input_Line() returned
 	int status_Exit_Value = 0; //for status exit value
 	char user_Input[MAX_CHARACTERS] = ""; //for users command
 	char status_Message[MAX_STATUS_CHARACTERS] = "";
-	// Set up a signal handler to deal with signals from child processes
-	// this code is taken from http://pubs.opengroup.org/onlinepubs/009695399/functions/sigaction.html
-	struct sigaction act; //creating a structure variable, which will be called in sigaction function with the conrol signal variable
-	act.sa_handler = signal_Child_Handler; // this is declaring which handler is used if controll signal is passed to the structure
-	//this command used to change the actions taken by a process on receipt of specific signal
-	//int sigaction(int signum, const struct sigaction *act, struct sigaction *oldact);
-	//signum specifies the signal and can be any valid signal except SIGKILL and SIGSTOP
-	//act is a non_NULL, the new actions for signal signum is snstalled from act.{action to be taken}
-	//the signacture structure definition can be found on http://man7.org/linux/man-pages/man2/sigaction.2.html
-	//The structure sigaction, used to describe an action to be taken, is defined in the <signal.h> header
-    //https://www.youtube.com/watch?v=nj6r47F6cNQ -- evenhandling lecture
-    //https://www.youtube.com/watch?v=ahRBRGVTi5w ---sigaction() lecture
-    //https://www.youtube.com/watch?v=rggw61JtGz0
-    //Catching SIGCHLD
-    //When a child process stops or terminates, SIGCHLD is
-    //sent to the parent process. The default response to the signal
-    //is to ignore it. The signal can be caught and the exit status
-    //from the child process can be obtained by immediately calling wait
-    //if our case will will catch a child that is terminated and call a child handling function
-	sigaction(SIGCHLD, &act, NULL);
+	struct parsed_Command parsed_Line; //users command broken into words
+	// There is no SIGCHLD handler, a handler calling waitpid(-1, ...) would also reap our foreground
+	//commands before foreground_Command gets to them. Background commands are checked just before
+	//we prompt for a new command instead, see check_Background_Jobs().
+	// The shell itself is not interrupted by ^C, we only count it. SA_RESTART keeps read() reading.
+	//SIGTERM and SIGHUP do interrupt it so we can write the metrics and exit
+	struct sigaction act;
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = count_Signal_Handler;
+	act.sa_flags = SA_RESTART;
+	sigaction(SIGINT, &act, NULL);
+	act.sa_flags = 0;
+	sigaction(SIGTERM, &act, NULL);
+	sigaction(SIGHUP, &act, NULL);
+	// Start the variable store from the environment we were given
+	if (init_Variable_Store(&shell_Variables, environ) < 0){
+		perror("smallsh");
+		exit(1);
+	}
+	// Metrics export, see write_Metrics()
+	metrics_File_Path = getenv("SMALLSH_METRICS_FILE");
+	if (getenv("SMALLSH_METRICS_INTERVAL") != NULL){
+		// the whole value has to be a number of seconds, atof() would turn a typo like 15s into 0, every prompt
+		const char *interval_Text = getenv("SMALLSH_METRICS_INTERVAL");
+		char *number_End;
+		double interval_Seconds = strtod(interval_Text, &number_End);
+		if (number_End == interval_Text || *number_End != '\0' || !isfinite(interval_Seconds) || interval_Seconds < 0){
+			fprintf(stderr, "smallsh: SMALLSH_METRICS_INTERVAL must be a number of seconds, not %s, using 15\n", interval_Text);
+		}
+		else{
+			// 31 years is as good as never and still fits in nanoseconds after adding a time stamp
+			if (interval_Seconds > 1000000000.0){
+				interval_Seconds = 1000000000.0;
+			}
+			metrics_Interval = (long long)(interval_Seconds * 1000000000.0);
+		}
+	}
+	last_Metrics_Write = metrics_Now();
+	atexit(write_Metrics_At_Exit);
+	// Line status reports for smallsh_replay, see report_Line_Status()
+	if (getenv("SMALLSH_STATUS_FD") != NULL){
+		status_Report_Fd = atoi(getenv("SMALLSH_STATUS_FD"));
+		// the commands we launch should not inherit it
+		if (fcntl(status_Report_Fd, F_SETFD, FD_CLOEXEC) < 0){
+			status_Report_Fd = -1;
+		}
+	}
     while (exit_Shell_Request == 0){
          fflush(stdin);//had to add this, see canvas discussion
 		// Clear stdin
@@ -164,29 +280,58 @@ int main(){
         // Calling fflush means  that you flush the buffer when you need the output right away..
         //on canvas per Benjamin Brewster Before you display your prompt, call fflush(). :)
 		fflush(stdout);
+		// The previous line is done
+		if (line_Was_Read){
+			report_Line_Status(status_Exit_Value);
+		}
+		// Report the background processes that completed since the last prompt
+		check_Background_Jobs();
+		write_Metrics(1);
+		// SIGTERM or SIGHUP arrived while the last command was running
+		exit_If_Terminated();
         // Get user input and sends formated output to the screen
 		printf(": ");
-		//Reads characters from stream and stores them as a C string into str until (num-1) characters have been
-		//read or either a newline or the end-of-file is reached, whichever happens first.
-		//in our case, we take string that the user entered using the keyboard and store it in the variable user_Input
-		fgets(user_Input, 100, stdin);
+		// a terminal has to see the prompt before we wait. Into a pipe the prompt still goes out with the
+		//next line's output, after the line is read, so smallsh_replay always finds it there
+		if (isatty(STDOUT_FILENO)){
+			fflush(stdout);
+		}
+		wait_For_Input();
+		// we take the line that the user entered using the keyboard and store it in the variable user_Input,
+		//without the new line character, see read_Input_Line()
+		read_Result = read_Input_Line(user_Input, MAX_CHARACTERS);
+		line_Was_Read = (read_Result != 0);
 		fflush(stdout);
-        // remove new line character from the string and replace it with NUll character
-        size_t ln = strlen(user_Input) - 1;
-        if (user_Input[ln] == '\n') {
-            user_Input[ln] = '\0';
-        }
+		// the rest of a line longer than user_Input would otherwise run as the next command
+		if (read_Result < 0){
+			printf("smallsh: command line too long\n");
+			strncpy(status_Message, "", MAX_STATUS_CHARACTERS);
+			status_Exit_Value = 1;
+			foreground_Signal_Number = 0;
+			continue;
+		}
+		// SIGTERM or SIGHUP arrived while we were waiting for input
+		exit_If_Terminated();
 		// If you at the end of an input file, then exit.
 		//Check End-of-File indicator
         //Checks whether the End-of-File indicator associated with stream is set, returning a value different from zero if it is.
         //if the end of the file was reached we would want to exit
 		//taken from discussion board
-		  if (feof(stdin)) {       // if end-of-file reached, then we are in a script
+		  if (input_At_End) {       // if end-of-file reached, then we are in a script
             // http://stackoverflow.com/questions/23978444/c-redirect-stdin-to-keyboard
             //printf("End of the file!\n");
-            if (!freopen("/dev/tty", "r", stdin)) {        // re-open stdin as a terminal
-            perror("/dev/tty");
-            exit(1);
+            //without a terminal (for example when smallsh_replay runs us) we finish this line and exit.
+            //The terminal is opened first and only then put on descriptor 0, freopen() would close stdin even when
+            //it fails and the command on this line would get descriptor 0 for its redirection or pipe
+            int terminal_Fd = open("/dev/tty", O_RDONLY);
+            if (terminal_Fd >= 0 && dup2(terminal_Fd, STDIN_FILENO) >= 0) {        // re-open stdin as a terminal
+                input_At_End = 0;
+            }
+            else {
+                exit_Shell_Request = 1;
+            }
+            if (terminal_Fd > STDIN_FILENO) {
+                close(terminal_Fd);
             }
         }
 		// if the user accidentally pressed enters without entering any commands
@@ -205,12 +350,12 @@ int main(){
 		    //printf("you typed cd!\n");
         //the following code was found on the https://github.com/joelpet/SmallShell/blob/master/smallshell.c#L216
         //i had no idea what that function meant
-        //http://www.tutorialspoint.com/c_standard_library/c_function_getenv.htm
-        //The getenv() function shall search the environment of the calling process for the environment
-         //variable name if it exists and return a pointer to the value of the environment variable.
-        char* home_Path = getenv("HOME");
+        //HOME is looked up in our variable store, so export HOME=... and unset HOME work like in sh
+        const char* home_Path = get_Variable(&shell_Variables, "HOME");
   		// once the home directory is found, we change the current directory to the home directory
-        chdir(home_Path);
+        if (home_Path != NULL){
+            chdir(home_Path);
+        }
         continue;
 		}
 		///if the user enters CD DIRECTORY_NAME for the command this is an indication that they want to go to a specific directory
@@ -218,18 +363,19 @@ int main(){
 		//directory that they want to
 		if ((user_Input[0] == 'c') && (user_Input[1] == 'd') && (user_Input[2] == ' ')){
 		   // printf("you typed cd plus something else\n");
-			char *arguments_Array[MAX_ARGUMENTS];
-			//initialize array to null
-            int i;
-            for(i = 0; i < MAX_ARGUMENTS; i++){
-                arguments_Array[i] = 0;
-            }
-		// Get the users input and split it into words, see inforamtion on user defined functin for additional information
-			split_Users_Command_into_Arguments(user_Input, arguments_Array);
-			// the name of the directory will be stored at the index = 1 in the array that was
-			//derived from string tokanization into words, thus we change a directory to the name that is sroted under the
-			//index = 1. Index 0 will be the word cd.
-			chdir(arguments_Array[1]);
+		// Get the users input and split it into words, see libsmallsh.h for additional information
+			// the name of the directory will be stored at the index = 1 in the argument array
+			//Index 0 will be the word cd.
+			if ((parse_Command_Line(user_Input, &parsed_Line) == 0) && (parsed_Line.argv[1] != NULL)){
+				chdir(parsed_Line.argv[1]);
+			}
+			continue;
+		}
+		/// if the user enters word STATS for the command, show the metrics
+		if (strcmp(user_Input, "stats") == 0){
+			static char metrics_Text[METRICS_TEXT_SIZE];
+			format_Metrics(metrics_Text, sizeof(metrics_Text));
+			fputs(metrics_Text, stdout);
 			continue;
 		}
 		/// if the user enters word STATUS for the command
@@ -245,6 +391,7 @@ int main(){
 			// Clear the status
 			strncpy(status_Message, "", MAX_STATUS_CHARACTERS);
 			status_Exit_Value = 0;
+			foreground_Signal_Number = 0;
 			continue;
 		}
         ///if the user enters # SING for commenting
@@ -265,489 +412,588 @@ int main(){
 			// Clean up the status if we didn't want to display it
 			strncpy(status_Message, "", MAX_STATUS_CHARACTERS);
 			status_Exit_Value = 0;
+			foreground_Signal_Number = 0;
 		}
 
+		// Get the users input and split it into words and redirections
+		if (parse_Command_Line(user_Input, &parsed_Line) < 0){
+			printf("%s\n", parsed_Line.error_Message);
+			status_Exit_Value = 1;
+			continue;
+		}
+		// a line with only redirections or only & has nothing to run, unless it sets variables
+		if (parsed_Line.argument_Count == 0){
+			if (parsed_Line.assignment_Count > 0){
+				status_Exit_Value = variable_Command(&parsed_Line);
+			}
+			continue;
+		}
+		/// if the user enters EXPORT or UNSET for the command
+		if (strcmp(parsed_Line.argv[0], "export") == 0 || strcmp(parsed_Line.argv[0], "unset") == 0){
+			status_Exit_Value = variable_Command(&parsed_Line);
+			continue;
+		}
+		/// if the user enters TIMEOUT for the command
+		if (strcmp(parsed_Line.argv[0], "timeout") == 0){
+			status_Exit_Value = timeout_Command(&parsed_Line, status_Message);
+			continue;
+		}
 		/// if the user enters & at the end of their command this is an indication that they want to
 		///do a background process
-		if (substring_Finder(user_Input, "&")){
+		if (parsed_Line.background){
             //printf("bachground process\n");
-			background_Command(user_Input);
+			background_Command(&parsed_Line);
 			continue;
 		}
 		//  foreground command
 		//printf("foregroud process!\n");
-		status_Exit_Value = foreground_Command(user_Input, status_Message);
+		status_Exit_Value = foreground_Command(&parsed_Line, status_Message, -1, -1);
+	}
+	// the last line of the input is done as well
+	fflush(stdout);
+	if (line_Was_Read){
+		report_Line_Status(status_Exit_Value);
 	}
 	return 0;
 }
 /*************************************************************************************************************
- * Function:  int foreground_Command(char *input_Command, char *status_Message)
+ * Function:  int foreground_Command(struct parsed_Command *parsed_Line, char *status_Message,
+ *                                    int timeout_Milliseconds, int kill_After_Milliseconds)
  * Description: Function that will run specified foreground command
- * Function will return 0 if the command executed without any error.
- * Parameters: command that the user have entered and that does NOT have an & sign
- * function adopted from or error message
+ * Function will return the exit value of the command, or 1 if it could not be started.
+ * Parameters: command that the user have entered and that does NOT have an & sign,
+ * the status message that is set if the command was terminated by a signal
+ * and the time limits used by the timeout command, -1 for no limit
  * https://www.youtube.com/watch?v=l64ySYHmMmY ---- use this for a makefile as well
  *  ***************************************************************************************************************/
 
-int foreground_Command(char *input_Command, char *status_Message){
-	int status = 0;
+int foreground_Command(struct parsed_Command *parsed_Line, char *status_Message, int timeout_Milliseconds, int kill_After_Milliseconds){
 	int status_Value = 0;
-	pid_t pid_After_Fork = -5; // per lecture notes, set it to -5, why? who knows- I really do not get this why -5?
-	int fd = -1;
-	// signal handler for the child, see main method for explanation
+	int launch_Flags = 0;
+	int wait_Result;
+	int timed_Out = 0;
+	int killed = 0;
+	int owns_Terminal = 0;
+	struct command_Handle handle;
+	// NULL would make launch_Command_Environment() use the environment we started with
+	char **environment = variable_Environment(&shell_Variables);
+	// signal handler for the parent, see main method for explanation
 	struct sigaction act;
-	//variable for the filename
-	char fileName[MAX_CHARACTERS] = "";
-	// Determine if we have any redirects
-	int output_Redirect = substring_Finder(input_Command, ">");
-	int input_Redirect = substring_Finder(input_Command, "<");
-	char *argv[MAX_ARGUMENTS];
-	int i;
-	//initialize array to null
-	for(i = 0; i < MAX_ARGUMENTS; i++){
-		argv[i] = 0;
-	}
-	// Get the file descriptor if we have to redirect output
-	if (output_Redirect == 1)	{
-		file_Name(input_Command, fileName);// this will give us the name of the file
-        //the redirected output file should be opened for write only
-		//it should be truncated if it already exists or created if it does not exist.
-		//if the shell cannot open the output file, it should print an error message and set exit status to 1
-		//O_TRUNC mode if you want to truncate an existing file and overwrite it with new data.
-		//O_WRONLY   Open for writing only
-		//O_CREAT   If the file exists, this flag has no effect except as noted under O_EXCL below. Otherwise, the file shall be created;
-		//0644 will create a file that is Read/Write for owner, and Read Only for everyone else..
-		fd = open(fileName, O_WRONLY|O_TRUNC|O_CREAT, 0644);
-	}
-
-	// Get the file descriptor if we have to redirect input
-	if (input_Redirect == 1)	{
-		file_Name(input_Command, fileName);// this will give us the name of the file
-        // Get the file descriptor if we have to redirect input
-        //if there is an input redirect character " <"
-        //O_RDONLY the redirected input file will be opened for reading only
-        //0644 will create a file that is Read/Write for owner, and Read Only for everyone else..
-		fd = open(fileName, O_RDONLY, 0644);
-	}
-	// Get all the args from the user entered command
-	split_Users_Command_into_Arguments(input_Command, argv);
-	// Start the child process for command execution
-	pid_After_Fork = fork();
-	//see lecture https://www.youtube.com/watch?v=EqndHT606Tw
-	//0-- stdin
-	//1---stdout
-	//2---srderror
-	switch (pid_After_Fork){
-		case -1:
-			// Fork failed
-			perror("fork()error"); //not sure if we need this
-			exit(1);
-			break;
-		case 0:
-			/// CHILD
-			// Establish the std output redirect, exit if error is found
-			//http://pubs.opengroup.org/onlinepubs/009695399/functions/dup.html
-			//int dup2 (int old, int new)---This function copies the descriptor old to descriptor number new.
-			if ((output_Redirect) && (dup2(fd, 1) < 0)){
-				exit(1);
-			}
-
-			// Establish the std input redirect, exit if error is found.
-			if ((input_Redirect) && (dup2(fd, 0) < 0)){
-				printf("smallsh: cannot open %s for input\n", fileName);
-				exit(1);
-			}
-			// Set up the signal handler for the child process to not ignore termination signals
-			//SIG_DFL specifies the default action for the particular signal
-			act.sa_handler = SIG_DFL;
-            //Catching SIGCHLD
-            //When a child process stops or terminates, SIGCHLD is
-            //sent to the parent process. The default response to the signal
-            //is to ignore it. The signal can be caught and the exit status
-            //from the child process can be obtained by immediately calling wait
-            //if our case will will catch a child that is terminated and call a child handling function
-			sigaction(SIGINT, &act, NULL);
- 	 		close(fd);
-        // Try to execute the user command
-        //first elements of the array is the name of the file
-        //http://www.cs.ecu.edu/karl/4630/sum01/example1.html
-        //http://stackoverflow.com/questions/14301407/how-does-execvp-run-a-command
-        //http://www.xinotes.net/notes/note/1829/
-        //http://www.opennet.ru/man.shtml?topic=execvp&category=2&russian=4
-        //The first argument, by convention, should point to the filename associated with the file being executed. The array of pointers must be terminated by a NULL pointer.
-  		execvp(argv[0], argv);
-  		printf("%s: no such file or directory\n", argv[0]);
-  		exit(1);
-        break;
-		default:
-			///PARENT
-			close(fd);
-			// Set up the signal handler for the parent process to ignore termination messages
-			//SIG_DFL specifies the default action for the particular signal
-			//SIG_IGN specifies that the signal should be ignored.
-			act.sa_handler = SIG_DFL;
-			act.sa_handler = SIG_IGN;
-			sigaction(SIGINT, &act, NULL);
-			// Wait for child process to finish
-            //Catching SIGCHLD
-            //When a child process stops or terminates, SIGCHLD is
-            //sent to the parent process. The default response to the signal
-            //is to ignore it. The signal can be caught and the exit status
-            //from the child process can be obtained by immediately calling wait
-            //if our case will will catch a child that is terminated and call a child handling function
-			waitpid(pid_After_Fork, &status, 0);
-			//http://www-01.ibm.com/support/knowledgecenter/SSB23S_1.1.0.11/com.ibm.ztpf-ztpfdf.doc_put.11/gtpc2/cpp_wexitstatus.html?cp=SSB23S_1.1.0.11%2F0-3-8-1-0-17-3
-			//we obtain exit stutus of the child
-			status_Value = WEXITSTATUS(status);
-            //Query status to see if a child process ended abnormally
-			// Save the appropriate signal error message
-			//http://www.qnx.com/developers/docs/6.5.0/index.jsp?topic=%2Fcom.qnx.doc.neutrino_lib_ref%2Fs%2Fsnprintf.html
-			if(WIFSIGNALED(status)) {
-                //Determine which signal caused the child process to exit.
-				int signal_Number = WTERMSIG(status);
-				char terminateMsg[MAX_STATUS_CHARACTERS];
-				char signal_Number_String[25];
-                //Write formatted output to a character array, up to a given maximum number of characters
-   				snprintf(signal_Number_String, sizeof(signal_Number_String), "%d", signal_Number);
-
-                // Output the termination message and save it for the status command
-				strncpy(terminateMsg, "terminated by signal ", MAX_STATUS_CHARACTERS);
-				strcat(terminateMsg, signal_Number_String);
-				printf("%s\n", terminateMsg);
-				strncpy(status_Message, terminateMsg, MAX_STATUS_CHARACTERS);
-			}
-
-			break;
+	struct sigaction previous_Act;
+	if (environment == NULL){
+		printf("smallsh: out of memory building the environment\n");
+		return 1;
 	}
-
+	// The shell does not stop on ^C (see main), the child gets SIG_DFL back in launch_Command
+	//so ^C only stops the command.
+	// a timed command gets a process group of its own so the timeout can stop everything it started.
+	//On a terminal that group gets the terminal, like timeout --foreground, so it can read it and ^C and ^Z
+	//go to it. Otherwise we have to pass ^C on to it ourselves
+	if (timeout_Milliseconds >= 0){
+		launch_Flags |= LAUNCH_NEW_PROCESS_GROUP | LAUNCH_TERMINAL_FOREGROUND;
+		owns_Terminal = isatty(STDIN_FILENO) && tcgetpgrp(STDIN_FILENO) == getpgrp();
+		memset(&act, 0, sizeof(act));
+		act.sa_handler = forward_Interrupt_Handler;
+		act.sa_flags = SA_RESTART;
+		sigaction(SIGINT, &act, &previous_Act);
+	}
+	// Start the child process for command execution with its redirections
+	if (launch_Command_Environment(parsed_Line, launch_Flags, environment, &handle) < 0){
+		printf("%s\n", handle.error_Message);
+		if (timeout_Milliseconds >= 0){
+			sigaction(SIGINT, &previous_Act, NULL);
+		}
+		return 1;
+	}
+	foreground_Process_Group = handle.process_Group;
+	if (handle.exec_Errno != 0){
+		printf("%s: no such file or directory\n", parsed_Line->argv[0]);
+	}
+	// Wait for child process to finish, or for the time limit
+	wait_Result = wait_Foreground_Command(&handle, timeout_Milliseconds);
+	if (wait_Result == 0){
+		// Out of time, ask the whole group to terminate. SIGCONT wakes up anything that is stopped
+		//so it can act on the SIGTERM, the same as the coreutils timeout command does
+		timed_Out = 1;
+		count_Metric(METRIC_COMMANDS_TIMED_OUT);
+		signal_Command(&handle, SIGTERM);
+		signal_Command(&handle, SIGCONT);
+		wait_Result = wait_Foreground_Command(&handle, kill_After_Milliseconds);
+		if (wait_Result == 0){
+			killed = 1;
+			signal_Command(&handle, SIGKILL);
+			wait_Result = wait_Foreground_Command(&handle, -1);
+		}
+	}
+	foreground_Process_Group = 0;
+	if (timeout_Milliseconds >= 0){
+		sigaction(SIGINT, &previous_Act, NULL);
+		// take the terminal back from the group of the command
+		if (owns_Terminal){
+			set_Terminal_Process_Group(getpgrp());
+		}
+	}
+	if (wait_Result == 1){
+		status_Value = handle.exit_Value;
+		foreground_Signal_Number = handle.signal_Number;
+		//Query status to see if a child process ended abnormally
+		// Save the appropriate signal error message
+		if (handle.signal_Number != 0 && !timed_Out){
+			status_Value = 0;
+			snprintf(status_Message, MAX_STATUS_CHARACTERS, "terminated by signal %d", handle.signal_Number);
+			printf("%s\n", status_Message);
+		}
+	}
+	if (timed_Out){
+		status_Value = killed ? 137 : 124;
+	}
+	release_Command(&handle);
 	return status_Value;
 }
 
  /*************************************************************************************************************
- * Function:  int background_Command(char *input_Command)
+ * Function:  int background_Command(struct parsed_Command *parsed_Line)
  * Description: Function that will run specified background command
- * Function will return 0 if the command executed without any error.
+ * Function will return 0 if the command was started without any error.
  * Parameters: command that the user have entered and that has an & sign
  * function adopted from https://github.com/swanyriver/small-shell/blob/master/prepare.c
  * https://www.youtube.com/watch?v=xVSPv-9x3gk
  *  ***************************************************************************************************************/
 
-int background_Command(char *input_Command){
-	int status_Value = 0;
-	pid_t pid_After_Fork = -5; //taken from lecture
-	char pid_After_Fork_String[25];
-	int fd = -1;
-	//variable for filename
-	char fileName[MAX_CHARACTERS] = "";
-	// Check if we have any redirects
-	int output_Redirect = substring_Finder(input_Command, ">");
-	int input_Redirect = substring_Finder(input_Command, "<");
-
-	char *argv[MAX_ARGUMENTS];
-    //initialize array to null
-	int i;
-	for(i = 0; i < MAX_ARGUMENTS; i++){
-		argv[i] = 0;
-	}
-	// Get the file descriptor if we have to redirect output
-	//first we check if there is a output redirect character ">"
-	if (output_Redirect == 1)	{
-		file_Name(input_Command, fileName);// we take the name that the user indicated and store it in the filename variable
-		//the redirected output file should be opened for write only
-		//it should be truncated if it already exists or created if it does not exist.
-		//if the shell cannot open the output file, it should print an error message and set exit status to 1
-		//O_TRUNC mode if you want to truncate an existing file and overwrite it with new data.
-		//O_WRONLY   Open for writing only
-		//O_CREAT   If the file exists, this flag has no effect except as noted under O_EXCL below. Otherwise, the file shall be created;
-		//0644 will create a file that is Read/Write for owner, and Read Only for everyone else..
-		fd = open(fileName, O_WRONLY|O_TRUNC|O_CREAT, 0644);
-	}
-
-	// Get the file descriptor if we have to redirect input
-	//if there is an input redirect character " <"
-	//O_RDONLY the redirected input file will be opened for reading only
-	if (input_Redirect == 1){
-		file_Name(input_Command, fileName);//we take the name of the file that the user indicated and store it in the filename variable
-		fd = open(fileName, O_RDONLY, 0644);
-	}
-	//if the user did not specify redirection, redirect stdin to dev/null
-	//http://unix.stackexchange.com/questions/163352/what-does-dev-null-21-mean-in-this-article-of-crontab-basics
-	//dev/null is a black hole where any data sent, will be discarded
+int background_Command(struct parsed_Command *parsed_Line){
+	struct command_Handle *handle;
+	char **environment;
+	if (background_Job_Count == MAX_BACKGROUND_JOBS){
+		printf("smallsh: too many background processes\n");
+		return 1;
+	}
+	// NULL would make launch_Command_Environment() use the environment we started with
+	environment = variable_Environment(&shell_Variables);
+	if (environment == NULL){
+		printf("smallsh: out of memory building the environment\n");
+		return 1;
+	}
+	handle = &background_Jobs[background_Job_Count];
+	// Start the child process, its stdin is /dev/null unless the user redirected it
+	if (launch_Command_Environment(parsed_Line, 0, environment, handle) < 0){
+		printf("%s\n", handle->error_Message);
+		return 1;
+	}
+	background_Job_Count++;
+	set_Background_Jobs_Metric(background_Job_Count);
+	if (handle->exec_Errno != 0){
+		printf("%s: no such file or directory\n", parsed_Line->argv[0]);
+	}
+	// Output the process ID message for background processes
+	//when a background process terminates, check_Background_Jobs reaps it and prints its exit status
+	printf("background pid is %d\n", (int)handle->pid);
+	return 0;
+}
+
+ /*************************************************************************************************************
+ * Function:  static int parse_Duration(const char *duration_Text, int *milliseconds)
+ * Description: Function converts a duration like 10, 2.5s, 3m, 1h or 1d into milliseconds.
+ * A duration of 0 means no limit and gives -1.
+ * returns 0 - on success, returns -1 - if the text is not a valid duration
+ ***************************************************************************************************************/
+static int parse_Duration(const char *duration_Text, int *milliseconds){
+	char *suffix;
+	double seconds = strtod(duration_Text, &suffix);
+	// strtod also takes nan and inf, converting those to int below would be undefined
+	if (suffix == duration_Text || !isfinite(seconds) || seconds < 0){
+		return -1;
+	}
+	if (strcmp(suffix, "m") == 0){
+		seconds *= 60;
+	}
+	else if (strcmp(suffix, "h") == 0){
+		seconds *= 60 * 60;
+	}
+	else if (strcmp(suffix, "d") == 0){
+		seconds *= 24 * 60 * 60;
+	}
+	else if (strcmp(suffix, "") != 0 && strcmp(suffix, "s") != 0){
+		return -1;
+	}
+	if (seconds == 0){
+		*milliseconds = -1;
+	}
+	// poll() takes an int number of milliseconds, that is a bit more than 24 days
+	else if (seconds * 1000 >= 2147483647.0){
+		*milliseconds = 2147483647;
+	}
 	else{
-		fd = open("/dev/null", O_RDONLY);
-		fflush(stdin);
-	}
-
-	// Get the args from the user entered string
-	split_Users_Command_into_Arguments(input_Command, argv);
-
-	// Start the child process for command execution
-	//System call fork() is used to create processes. It takes no arguments and returns a process ID.
-	//The purpose of fork() is to create a new process, which becomes the child process of the caller.
-	// After a new child process is created, both processes will execute the next instruction following the fork() system call
-	//code taken from http://stackoverflow.com/questions/23036475/program-of-forking-processes-using-switch-statement-in-c
-	pid_After_Fork = fork();
-	switch (pid_After_Fork){
-		case -1:// Error in forking, we will exit.
-			exit(1);
-			break;
-        //https://www.cs.rutgers.edu/~pxk/416/notes/c-tutorials/dup2.html
-        //We get a file name from the command line and create it as a new file, getting a file descriptor for it.
-        //We then write something to the standard output using printf and the stdio library.
-        //After that, we use dup2 to copy the file descriptor for the new file (newfd) onto the standard output
-        //file descriptor (1). Any printf functions will continue to go to the standard output,
-        //but that has now been changed to the file we just opened.
-		case 0:// This code will be executed by the child process
-		    //if there is an output redirect and if and the redirect standard output to the file using dup2 is successful
-			if ((output_Redirect) && (dup2(fd, 1) < 0)){
-				// Establish the std output redirect, exit if error is found.
-				exit(1);
-			}
-			else if ((dup2(fd, 0) < 0)){// Establish the std input redirect, exit if error is found.
-				printf("smallsh: cannot open %s for input\n", fileName);
-				exit(1);
-			}
-   	 		close(fd);// Execute the user's command
-            //execution. As a result, once the specified program file starts its execution, the original program in the
-            //caller's address space is gone and is replaced by the new program.
-            //this is done to make sure that child does not run the same proccess of the parent
-            //http://www.csl.mtu.edu/cs4411.ck/www/NOTES/process/fork/exec.html
-	  		execvp(argv[0], argv);
-	  		// if the name indicated by the user does not exist, the error message is displayed letting the user know that file does not exist
-	  		printf("%s: no such file or directory\n", argv[0]);
-	  		exit(1);
-			break;
-		default:// This code will be run by the parent process.
-			close(fd);// Output the process ID message for background processes
-			//when a background process terminates, a message showing the process id and exit status will be printed
-			//snprintf is essentially a function that redirects the output of printf to a buffer.
-			snprintf(pid_After_Fork_String, sizeof(pid_After_Fork_String), "%d", pid_After_Fork);
-			//message is printed
-			printf("background pid is %s\n", pid_After_Fork_String);
+		*milliseconds = (int)(seconds * 1000);
+	}
+	return 0;
+}
+
+ /*************************************************************************************************************
+ * Function:  int timeout_Command(struct parsed_Command *parsed_Line, char *status_Message)
+ * Description: Built in command timeout DURATION [--kill-after D] command [arg1 arg2 ...]
+ * see the declaration at the top of the file for the details
+ * Parameters: parsed command line starting with the word timeout and the status message
+ ***************************************************************************************************************/
+
+int timeout_Command(struct parsed_Command *parsed_Line, char *status_Message){
+	int timeout_Milliseconds = -1;
+	int kill_After_Milliseconds = -1;
+	const char *duration_Text = NULL;
+	const char *kill_After_Text = NULL;
+	int word = 1;
+	// the options can come before or after the duration, the first other word after the duration is the command
+	while (parsed_Line->argv[word] != NULL){
+		if (strcmp(parsed_Line->argv[word], "--kill-after") == 0 && parsed_Line->argv[word + 1] != NULL){
+			kill_After_Text = parsed_Line->argv[word + 1];
+			word += 2;
+		}
+		else if (strncmp(parsed_Line->argv[word], "--kill-after=", strlen("--kill-after=")) == 0){
+			kill_After_Text = parsed_Line->argv[word] + strlen("--kill-after=");
+			word++;
+		}
+		else if (duration_Text == NULL){
+			duration_Text = parsed_Line->argv[word];
+			word++;
+		}
+		else{
 			break;
+		}
 	}
-	return status_Value;
+	if (duration_Text == NULL || parsed_Line->argv[word] == NULL){
+		printf("smallsh: usage: timeout DURATION [--kill-after D] command [arg1 arg2 ...]\n");
+		return 125;
+	}
+	if (parse_Duration(duration_Text, &timeout_Milliseconds) < 0){
+		printf("smallsh: timeout: invalid duration %s\n", duration_Text);
+		return 125;
+	}
+	if (kill_After_Text != NULL && parse_Duration(kill_After_Text, &kill_After_Milliseconds) < 0){
+		printf("smallsh: timeout: invalid duration %s\n", kill_After_Text);
+		return 125;
+	}
+	// we only wait for foreground commands, nothing would enforce the limit of a background one
+	if (parsed_Line->background){
+		printf("smallsh: timeout: only foreground commands can have a time limit\n");
+		return 125;
+	}
+	// drop the timeout words, the rest of the line is the command to run
+	memmove(parsed_Line->argv, parsed_Line->argv + word, (parsed_Line->argument_Count - word + 1) * sizeof(char *));
+	parsed_Line->argument_Count -= word;
+	return foreground_Command(parsed_Line, status_Message, timeout_Milliseconds, kill_After_Milliseconds);
 }
 
-/*************************************************************************************************************
- * Function:  static void signal_Child_Handler (int sig){
- * Description: Function that will monitor the child signals(when SIGCHLD signal is received by parent) and
- * determining which termination method or completion exit value to display. This is the void handler function for the
- *
- *       struct sigaction {
- *              void     (*sa_handler)(int);
- *              void     (*sa_sigaction)(int, siginfo_t *, void *);
- *              sigset_t   sa_mask;
- *              int        sa_flags;
- *              void     (*sa_restorer)(void);
- *          };
- * this function is required to user int sigaction(int signum, const struct sigaction *act, struct sigaction *oldact)
- * function, which will be used in the main function to change actions taken by a process on receipts of specific signal
- * Function will return 0 if the command executed without any error.
- * Parameters: command that the user have entered and that has an & sign
- * function adopted from https://github.com/swanyriver/small-shell/blob/master/prepare.c
- * https://github.com/ianks/shell-lab/blob/master/tsh.cc
- * http://man7.org/tlpi/code/online/diff/procexec/multi_SIGCHLD.c.html
- * http://www.linuxprogrammingblog.com/code-examples/SIGCHLD-handler
- * https://www.youtube.com/watch?v=ls5cGi12kGw
- * https://github.com/mptcp-nexus/android_system_netd/blob/master/main.cpp
- * http://openverse.com/~andy/devel/old/eat/src/pty.c
- * http://www.cs.rit.edu/usr/local/pub/wrc/courses/sp1/textbooks/tlpi-dist/procexec/multi_SIGCHLD.c
- * https://www.youtube.com/watch?v=M-qtkcLQJG0
+ /*************************************************************************************************************
+ * Function:  static void check_Background_Jobs(void)
+ * Description: Function checks if any background processes completed and prints their process id and
+ * exit status, for example "background pid 5253 is done: exit value 0". All the pidfds are checked with a
+ * single poll() that does not wait, only the ones that are readable are reaped.
+ * http://man7.org/linux/man-pages/man2/pidfd_open.2.html
+ * http://man7.org/linux/man-pages/man2/wait.2.html
  * ***************************************************************************************************************/
-static void signal_Child_Handler (int sig){
-	int status;
-	//The pid_t data type represents process IDs
-	pid_t pid_Child;
-	// Close all zombie child processes by waiting for it.
-    // Wait for all dead processes.
-    // We use a non-blocking call to be sure this signal handler will not
-	// block if a child was cleaned up in another part of the program.
-	//this will wait untill no more dead children are found
-
-	while ((pid_Child = waitpid(-1, &status, WNOHANG)) > 0){
-		// Convert the child pid to a string
-		char pid_After_Fork_String[10];
-		snprintf(pid_After_Fork_String, sizeof(pid_After_Fork_String), "%d", pid_Child);
-		// Declare the message variable
-		char child_Terminating_Message[MAX_STATUS_CHARACTERS];
-		///When background process terminates, a message showing the proccess id and exit status is displayed
-		///CODE TO GET AND DISPLAY PROCCESS ID
-		// Construct the child terminate message
-		//  Example: "background pid 5253 is done: exit value is displayed"
-		strncpy(child_Terminating_Message, "\nbackground pid ", MAX_STATUS_CHARACTERS);
-		//concatenate background message with the pdi and the rest of the background message
-		strcat(child_Terminating_Message, pid_After_Fork_String);
-		strcat(child_Terminating_Message, " is done: ");
-		///CODE TO GET AND DISPLAY EXIT STATUS
-		//we need to determine the reason of the termination and display appropriate message
-		// If child was terminated by a signal, then display the correct message
-		//this is taken from the Eric Anderson on the discussion board
-		//http://man7.org/linux/man-pages/man2/wait.2.html
-		//http://manpages.ubuntu.com/manpages/hardy/man2/wait.2.html
+static void check_Background_Jobs(void){
+	struct pollfd poll_Fds[MAX_BACKGROUND_JOBS];
+	int i;
+	if (background_Job_Count == 0){
+		return;
+	}
+	for (i = 0; i < background_Job_Count; i++){
+		poll_Fds[i].fd = background_Jobs[i].pid_Fd;
+		poll_Fds[i].events = POLLIN;
+		poll_Fds[i].revents = 0;
+	}
+	// a timeout of 0 makes poll() return right away
+	if (poll(poll_Fds, background_Job_Count, 0) < 0){
+		return;
+	}
+	// go backwards so moving the last job into a finished job's place does not skip anything
+	for (i = background_Job_Count - 1; i >= 0; i--){
+		struct command_Handle *job = &background_Jobs[i];
+		int done;
+		// without a pidfd we have to ask wait4 every time
+		if (poll_Fds[i].revents == 0 && job->pid_Fd >= 0){
+			continue;
+		}
+		done = poll_Command(job);
+		if (done == 0){
+			continue;
+		}
+		if (done < 0){
+			printf("%s\n", job->error_Message);
+		}
 		//  WIFSIGNALED(status)  returns true if the child process was terminated by a signal.
-		if(WIFSIGNALED(status)) {
-            ///GET A NUMBER OF SIGNAL THAT TERMINATED THE PROCESS
-            // WTERMSIG(status)
-            // returns the number of the signal that caused the child process
-            // to terminate.  This macro should be employed only if
-            // WIFSIGNALED returned true
-            int signal_Number = WTERMSIG(status);
-            char signal_Number_String[10]; //variable that will store the string once the signal number is converted to a string
-            snprintf(signal_Number_String, sizeof(signal_Number_String), "%d", signal_Number); // Convert signal number to a string
-   			//concatination of everything to display a final message
-            strcat(child_Terminating_Message, "terminated by signal ");
-            strcat(child_Terminating_Message, signal_Number_String);
-            strcat(child_Terminating_Message, "\n");
-            write(1, child_Terminating_Message, sizeof(child_Terminating_Message));
+		else if (job->signal_Number != 0){
+			printf("background pid %d is done: terminated by signal %d\n", (int)job->pid, job->signal_Number);
 		}
 		///IF COMPLETION WAS NORMAL, WE NEED TO GET EXIT VALUE
 		else{
-			// Child exited normally, write out the normal child process end message
-			char status_Number_String[5];
-			strcat(child_Terminating_Message, "exit value ");
-            // WEXITSTATUS(status)
-            // returns the exit status of the child.  This consists of the
-            //least significant 8 bits of the status argument that the child
-            //specified in a call to exit(3) or _exit(2) or as the argument
-            // for a return statement.
-            //http://man7.org/linux/man-pages/man2/wait.2.html
-			snprintf(status_Number_String, sizeof(status_Number_String), "%d", WEXITSTATUS(status)); // Convert status number to a string
-			strcat(child_Terminating_Message, status_Number_String);
-			strcat(child_Terminating_Message, "\n");
-			// Write out the message of the termination
-			write(1, child_Terminating_Message, sizeof(child_Terminating_Message));
-		}
-		continue;
+			printf("background pid %d is done: exit value %d\n", (int)job->pid, job->exit_Value);
+		}
+		release_Command(job);
+		background_Job_Count--;
+		background_Jobs[i] = background_Jobs[background_Job_Count];
 	}
+	set_Background_Jobs_Metric(background_Job_Count);
 }
 
  /*************************************************************************************************************
- * Function:  void split_Users_Command_into_Arguments(char *input_Command, char **command_Arguments)
- * Description: Function break users input into individual words and stores those words in the array
- * The function also checks for the presence of the <, >, and $ charactesr and does not include
- * them in the array. The function uses strtok() C function and uses white space as a delimiter.
- * code adopted from  http://codereview.stackexchange.com/questions/42990/tokenizing-string-using-strtok
- * http://faq.cprogramming.com/cgi-bin/smartfaq.cgi?answer=1061423302&id=1044780608
+ * Function:  static void forward_Interrupt_Handler(int sig)
+ * Description: Function passes ^C on to the process group of a timed foreground command.
+ * kill() is async signal safe, so it can be called from a signal handler
+ * http://man7.org/linux/man-pages/man7/signal-safety.7.html
  ***************************************************************************************************************/
+static void forward_Interrupt_Handler(int sig){
+	count_Signal_Metric(sig);
+	if (foreground_Process_Group > 0){
+		kill(-foreground_Process_Group, sig);
+	}
+}
 
-void split_Users_Command_into_Arguments(char *input_Command, char **command_Arguments){
-    char *current_Token;
-    int token_Number = 0;
-  // Determine if we have any redirect symbols
-    int output_Redirection_exit = substring_Finder(input_Command, ">");
-	int input_Redirection_Exist = substring_Finder(input_Command, "<");
-  //strtok will tokenize a string i.e. convert it into a series of substrings.
-  //It does that by searching for delimiters that separate these tokens (or substrings).
-  //And you specify the delimiters. In your case, you want ' ' or ',' or '.' or '-' to be the delimiter.
-  //in our case the delimiter will be " " ---whitespace
-  //we will take users input command and break it into words based on the whitespace delimiter.
-  //the output will be stored in the output array.
-    current_Token = strtok(input_Command, " ");
-    while (current_Token != NULL) {
-  	//if we find an output redirect symbol, exist the function
-  	if ((output_Redirection_exit == 1) && (strcmp(current_Token, ">") == 0)){
-    	break;
-    }
-  	// if we find an input redirect symbol, exit the function
-    if ((input_Redirection_Exist == 1) && (strcmp(current_Token, "<") == 0)) {
-    	break;
-    }
-    // if we find the & symbol which is used for the background processes, exit the function
-    if (strcmp(current_Token, "&") == 0){
-    	break;
-    }
-    //if none of the above mentioned symbols were encountered (<, >, and &) we store the word in the array
-  	command_Arguments[token_Number] = current_Token;
-    current_Token = strtok (NULL, " ");
-    //increment the tokes, which are words in our case
-    token_Number++;
-    // if the user extered to many arguments in the commend, we will exit the function
-    if (token_Number == (MAX_ARGUMENTS - 1)) {
-  		command_Arguments[MAX_ARGUMENTS - 1] = 0;
-    	break;
-    }
-  }
-  // Add the null terminator to the end of the array
-  command_Arguments[token_Number] = 0;
+ /*************************************************************************************************************
+ * Function:  static void count_Signal_Handler(int sig)
+ * Description: Function counts the signal, the metrics are lock free so this is async signal safe
+ ***************************************************************************************************************/
+static void count_Signal_Handler(int sig){
+	count_Signal_Metric(sig);
+	if (sig == SIGTERM || sig == SIGHUP){
+		terminate_Signal = sig;
+	}
+}
 
+ /*************************************************************************************************************
+ * Function:  static void exit_If_Terminated(void)
+ * Description: Function exits if SIGTERM or SIGHUP arrived, see the declaration at the top
+ ***************************************************************************************************************/
+static void exit_If_Terminated(void){
+	if (terminate_Signal != 0){
+		exit(128 + terminate_Signal);
+	}
 }
 
  /*************************************************************************************************************
- * Function:  void file_Name(char *input_Command, char *file_Name_Entered)
- * Description: Function that takes a user entered command and returns a file name
- * that the user entered in case there is a redirection
- * we use user defined helper function: (substring_Finder(string, substring),to check if the entered command
- * has < or > substrings
- * Parameters: users command and variable that will store the file name
+ * Function:  static void write_Metrics(int only_If_Due)
+ * Description: Function writes the metrics file if one was asked for, see the declaration at the top
+ * Parameters: 1 to write only if the interval has passed, 0 to write now
  ***************************************************************************************************************/
-void file_Name(char *input_Command, char *file_Name_Entered){
-	// 1st we check if there is a redirection
-	//if there is no redirection, we just can exit function
-	if ((substring_Finder(input_Command, "<") == 0) && (substring_Finder(input_Command, ">") == 0))	{
+static void write_Metrics(int only_If_Due){
+	long long now;
+	if (metrics_File_Path == NULL){
 		return;
 	}
-  	// Break all the commands into an array and find the first element
-	//  after the redirection signs
-	char *temporary_Array[MAX_ARGUMENTS];
-	char *current_Token;
-    int token_Number = 0;
-    int redirection_Position = 0;
-    //initiazile array to null
-	int i;
-	for(i = 0; i < MAX_ARGUMENTS; i++){
-		temporary_Array[i] = 0;
-	}
-    //we will increment though the user command and break it using the strtok() command
-    //strtok will tokenize a string i.e. convert it into a series of substrings.
-    //It does that by searching for delimiters that separate these tokens (or substrings).
-    //And you specify the delimiters. In your case, you want ' ' or ',' or '.' or '-' to be the delimiter.
-    //in our case the delimiter will be " " ---whitespace
-    current_Token = strtok(input_Command, " ");
-    //loop through the command until NUll character is encountered
-    while (current_Token != NULL) {
-  	// when the redirection character was encountered, save the position of that character
-  	  	if ((strcmp(current_Token, "<") == 0) || (strcmp(current_Token, ">") == 0)){
-  		redirection_Position = token_Number;// position is stored in the variable
-  	}
-    // Add the command arguments to the array one by one
-  	temporary_Array[token_Number] = current_Token;
-  	//tokens are separated based on the whitespace delimiter
-    current_Token = strtok (NULL, " ");
-    //incrementing of the tokens
-    token_Number++;
-    // in case the user entered to many arguments, we need to exist the function
-    if (token_Number == (MAX_ARGUMENTS - 1)) {
-  		temporary_Array[MAX_ARGUMENTS - 1] = 0;
-    	break;
-    }
-  }
-  // if get to this point, this is the indication that command size did not acccded the
-  //max allowed # of arguments, so we will get the file name
-  //first we need to make sure that the name was indicated, thus there is a value that is not equal to null after the < or > delimiter
-  if (temporary_Array[redirection_Position + 1] != 0) {
-    //name of the file is copied from the temporary array to the return value of this fucntion
-  	strncpy(file_Name_Entered, temporary_Array[redirection_Position + 1], MAX_CHARACTERS);
-  }
+	now = metrics_Now();
+	if (only_If_Due && now - last_Metrics_Write < metrics_Interval){
+		return;
+	}
+	last_Metrics_Write = now;
+	if (write_Metrics_File(metrics_File_Path) < 0){
+		perror(metrics_File_Path);
+	}
+}
+
+ /*************************************************************************************************************
+ * Function:  static void write_Metrics_At_Exit(void)
+ * Description: Function registered with atexit() so the last metrics are written however the shell exits
+ ***************************************************************************************************************/
+static void write_Metrics_At_Exit(void){
+	write_Metrics(0);
+}
+
+ /*************************************************************************************************************
+ * Function:  static int milliseconds_Until_Metrics(void)
+ * Description: Function returns the time until the metrics file is due, see the declaration at the top
+ ***************************************************************************************************************/
+static int milliseconds_Until_Metrics(void){
+	long long remaining;
+	// an interval of 0 means every prompt, not a busy loop
+	if (metrics_File_Path == NULL || metrics_Interval <= 0){
+		return -1;
+	}
+	// rounded up, so we do not wake up just before it is due and have to go round again
+	remaining = (last_Metrics_Write + metrics_Interval - metrics_Now() + 999999) / 1000000;
+	if (remaining < 0){
+		return 0;
+	}
+	return remaining > INT_MAX ? INT_MAX : (int)remaining;
+}
+
+ /*************************************************************************************************************
+ * Function:  static void wait_For_Input(void)
+ * Description: Function waits for standard input, see the declaration at the top
+ ***************************************************************************************************************/
+static void wait_For_Input(void){
+	sigset_t block_Set;
+	sigset_t previous_Set;
+	// the next line may already be in our buffer, then there is nothing to wait for
+	if (input_Start < input_End || input_At_End){
+		return;
+	}
+	sigemptyset(&block_Set);
+	sigaddset(&block_Set, SIGTERM);
+	sigaddset(&block_Set, SIGHUP);
+	sigprocmask(SIG_BLOCK, &block_Set, &previous_Set);
+	while (1){
+		fd_set read_Fds;
+		struct timespec wait_Time;
+		int ready;
+		int wait_Milliseconds = milliseconds_Until_Metrics();
+		exit_If_Terminated();
+		if (wait_Milliseconds == 0){
+			write_Metrics(0);
+			continue;
+		}
+		wait_Time.tv_sec = wait_Milliseconds / 1000;
+		wait_Time.tv_nsec = (wait_Milliseconds % 1000) * 1000000L;
+		FD_ZERO(&read_Fds);
+		FD_SET(STDIN_FILENO, &read_Fds);
+		// readable, end of file or an error all go to read_Input_Line(), it will tell
+		ready = pselect(STDIN_FILENO + 1, &read_Fds, NULL, NULL, wait_Milliseconds < 0 ? NULL : &wait_Time, &previous_Set);
+		if (ready > 0 || (ready < 0 && errno != EINTR)){
+			break;
+		}
+	}
+	sigprocmask(SIG_SETMASK, &previous_Set, NULL);
 }
 
+ /*************************************************************************************************************
+ * Function:  static int read_Input_Line(char *line, size_t line_Size)
+ * Description: Function reads one input line, see the declaration at the top
+ ***************************************************************************************************************/
+static int read_Input_Line(char *line, size_t line_Size){
+	size_t line_Length = 0;
+	int found_New_Line = 0;
+	int too_Long = 0;
+	while (!found_New_Line){
+		char *new_Line;
+		size_t chunk_Length;
+		if (input_Start == input_End){
+			ssize_t bytes_Read;
+			if (input_At_End){
+				break;
+			}
+			bytes_Read = read(STDIN_FILENO, input_Buffer, sizeof(input_Buffer));
+			if (bytes_Read < 0 && errno == EINTR){
+				// SIGTERM or SIGHUP, the line would not be run anyway
+				exit_If_Terminated();
+				continue;
+			}
+			// an error is the end of our input as well
+			if (bytes_Read <= 0){
+				input_At_End = 1;
+				break;
+			}
+			input_Start = 0;
+			input_End = bytes_Read;
+		}
+		// copy up to the new line, or all we have if it is not here yet
+		new_Line = memchr(input_Buffer + input_Start, '\n', input_End - input_Start);
+		chunk_Length = (new_Line != NULL ? (size_t)(new_Line - input_Buffer) : input_End) - input_Start;
+		if (!too_Long && line_Length + chunk_Length < line_Size){
+			memcpy(line + line_Length, input_Buffer + input_Start, chunk_Length);
+			line_Length += chunk_Length;
+		}
+		else{
+			too_Long = 1;
+		}
+		input_Start += chunk_Length;
+		if (new_Line != NULL){
+			found_New_Line = 1;
+			input_Start++;
+		}
+	}
+	line[line_Length] = '\0';
+	if (too_Long){
+		return -1;
+	}
+	// the last line of the input may not end with a new line
+	if (!found_New_Line && line_Length == 0){
+		return 0;
+	}
+	return 1;
+}
 
  /*************************************************************************************************************
- * Function:  int substring_Finder(char *search_String, char *substering_Of_Interst)
- * Description: Function to search for a specific substring in a string
- * Parameters: sting and substring
- * returns 1 - if substring was found
- * returns 2 - if substring was not founf\d
- * taken from http://articles.leetcode.com/2010/10/implement-strstr-to-find-substring-in.html
+ * Function:  static int wait_Foreground_Command(struct command_Handle *handle, int timeout_Milliseconds)
+ * Description: Function waits for a foreground command, see the declaration at the top
+ * returns what wait_Command_Timeout() returns
  ***************************************************************************************************************/
-int substring_Finder(char *search_String, char *substering_Of_Interst){
-    // Search for the specified string
-  //Returns a pointer to the first occurrence of str2 in str1, or a null pointer if str2 is not part of str1.
-  char *found_Substring = strstr(search_String, substering_Of_Interst);
-  if (found_Substring == 0) {
-  	return 0; // False, did not find the string.
-  }
-  else {
-  	return 1; // True, found the string.
-  }
+static int wait_Foreground_Command(struct command_Handle *handle, int timeout_Milliseconds){
+	long long deadline = metrics_Now() + (long long)timeout_Milliseconds * 1000000LL;
+	while (1){
+		int slice_Milliseconds = timeout_Milliseconds;
+		int metrics_Milliseconds = milliseconds_Until_Metrics();
+		int wait_Result;
+		if (timeout_Milliseconds >= 0){
+			long long remaining = (deadline - metrics_Now()) / 1000000LL;
+			slice_Milliseconds = remaining > 0 ? (int)remaining : 0;
+		}
+		if (metrics_Milliseconds >= 0 && (slice_Milliseconds < 0 || slice_Milliseconds > metrics_Milliseconds)){
+			slice_Milliseconds = metrics_Milliseconds;
+		}
+		wait_Result = wait_Command_Timeout(handle, slice_Milliseconds);
+		if (wait_Result != 0){
+			return wait_Result;
+		}
+		write_Metrics(1);
+		if ((timeout_Milliseconds >= 0) && (metrics_Now() >= deadline)){
+			return 0;
+		}
+	}
+}
+
+ /*************************************************************************************************************
+ * Function:  int variable_Command(struct parsed_Command *parsed_Line)
+ * Description: Built in commands export, unset and NAME=value, see the declaration at the top of the file
+ * Parameters: parsed command line
+ ***************************************************************************************************************/
+int variable_Command(struct parsed_Command *parsed_Line){
+	int status_Value = 0;
+	int i;
+	// NAME=value without a command, a variable that is already exported stays exported
+	if (parsed_Line->argument_Count == 0){
+		for (i = 0; i < parsed_Line->assignment_Count; i++){
+			if (set_Variable_Assignment(&shell_Variables, parsed_Line->assignments[i], -1) < 0){
+				printf("smallsh: cannot set %s\n", parsed_Line->assignments[i]);
+				status_Value = 1;
+			}
+		}
+		return status_Value;
+	}
+	if (strcmp(parsed_Line->argv[0], "unset") == 0){
+		for (i = 1; i < parsed_Line->argument_Count; i++){
+			if (unset_Variable(&shell_Variables, parsed_Line->argv[i]) < 0){
+				printf("smallsh: unset: %s: not a valid identifier\n", parsed_Line->argv[i]);
+				status_Value = 1;
+			}
+		}
+		return status_Value;
+	}
+	// export with no names shows what the commands we launch get
+	if (parsed_Line->argument_Count == 1){
+		char **environment = variable_Environment(&shell_Variables);
+		if (environment == NULL){
+			printf("smallsh: out of memory building the environment\n");
+			return 1;
+		}
+		for (i = 0; environment[i] != NULL; i++){
+			printf("export %s\n", environment[i]);
+		}
+		return 0;
+	}
+	for (i = 1; i < parsed_Line->argument_Count; i++){
+		if (set_Variable_Assignment(&shell_Variables, parsed_Line->argv[i], 1) < 0){
+			printf("smallsh: export: %s: not a valid identifier\n", parsed_Line->argv[i]);
+			status_Value = 1;
+		}
+	}
+	return status_Value;
+}
+
+ /*************************************************************************************************************
+ * Function:  static void report_Line_Status(int status_Exit_Value)
+ * Description: Function writes the status of the line that was just done to SMALLSH_STATUS_FD
+ * Parameters: exit value the status command would show
+ ***************************************************************************************************************/
+static void report_Line_Status(int status_Exit_Value){
+	if (status_Report_Fd >= 0){
+		dprintf(status_Report_Fd, "%d %d\n", status_Exit_Value, foreground_Signal_Number);
+	}
 }
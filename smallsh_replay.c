@@ -0,0 +1,845 @@
+/*********************************************************************************************************
+* Tatyana Vlaskin (vlaskint@onid.oregonstate.edu)
+* OregonState EECS
+* Filename: smallsh_replay.c
+*
+* Description: Record and replay smallsh sessions for load and regression testing.
+* 1. smallsh_replay record SESSION_FILE [--shell PATH]
+*    runs smallsh, passes it every line we read from standard input and writes each line to SESSION_FILE
+*    with the time it was entered, how long it took, its exit value, the signal that terminated it and
+*    everything the shell printed for it
+* 2. smallsh_replay replay SESSION_FILE [--shell PATH] [--speed original|max|FACTOR] [--shells N] [--iterations K]
+*    sends the recorded lines to N shells at once, at the original pace (or FACTOR times faster, or as fast
+*    as the shell answers), K times in a row, and reports throughput, the latency distribution and every
+*    line whose output or status is different from the recording
+* The shell is started in a new session without a terminal, with standard error going to standard output,
+* and with SMALLSH_STATUS_FD=3 so it tells us on file descriptor 3 when each line is done and how it ended.
+* Process ids change from run to run, so "background pid is N" is recorded as "background pid is #" and
+* the "background pid N is done" lines, which show up whenever the job happens to finish, are left out.
+* Exit value: 0 - replay matched the recording, 1 - some lines diverged, 2 - usage or system error.
+*
+* Session file: a "# smallsh session 1" line, then one line per input line with tab separated fields
+*   offset_us  latency_us  exit_value  signal  input  output
+* input and output are escaped: \\ \t \n and \xHH for other control characters.
+******************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#define MAX_CHARACTERS 2048
+#define SESSION_HEADER "# smallsh session 1"
+#define MAX_REPORTED_DIVERGENCES 10
+
+/*************************************************************************************************************
+ * Structure: struct session_Line
+ * Description: One recorded input line, output is the normalized output of the shell for that line
+ ***************************************************************************************************************/
+struct session_Line {
+	long long offset_Us;
+	long long latency_Us;
+	int exit_Value;
+	int signal_Number;
+	char *input;
+	char *output;
+};
+
+/*************************************************************************************************************
+ * Structure: struct shell_Process
+ * Description: A running smallsh with pipes to its standard input, standard output and status descriptor
+ ***************************************************************************************************************/
+struct shell_Process {
+	pid_t pid;
+	int input_Fd;
+	int output_Fd;
+	int status_Fd;
+	char status_Buffer[256];
+	size_t status_Length;
+};
+
+/*************************************************************************************************************
+ * Structure: struct text_Buffer
+ * Description: Growing buffer for the output of one line
+ ***************************************************************************************************************/
+struct text_Buffer {
+	char *text;
+	size_t length;
+	size_t capacity;
+};
+
+ /*************************************************************************************************************
+ * Function:  static long long microseconds_Now(void)
+ * Description: Function returns a monotonic time stamp in microseconds
+ ***************************************************************************************************************/
+static long long microseconds_Now(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long)now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+ /*************************************************************************************************************
+ * Function:  static void append_Text(struct text_Buffer *buffer, const char *text, size_t length)
+ * Description: Function adds text to the buffer, exits if we run out of memory
+ ***************************************************************************************************************/
+static void append_Text(struct text_Buffer *buffer, const char *text, size_t length){
+	if (buffer->length + length + 1 > buffer->capacity){
+		size_t new_Capacity = buffer->capacity ? buffer->capacity : 1024;
+		while (buffer->length + length + 1 > new_Capacity){
+			new_Capacity *= 2;
+		}
+		buffer->text = realloc(buffer->text, new_Capacity);
+		if (buffer->text == NULL){
+			perror("smallsh_replay");
+			exit(2);
+		}
+		buffer->capacity = new_Capacity;
+	}
+	memcpy(buffer->text + buffer->length, text, length);
+	buffer->length += length;
+	buffer->text[buffer->length] = '\0';
+}
+
+ /*************************************************************************************************************
+ * Function:  static char *normalize_Output(const char *output)
+ * Description: Function removes what changes from run to run: the pid in "background pid is N" becomes #
+ * and "background pid N is done: ..." lines are dropped.
+ * returns a malloc'd string
+ ***************************************************************************************************************/
+static char *normalize_Output(const char *output){
+	struct text_Buffer normalized = {NULL, 0, 0};
+	const char *line = output;
+	append_Text(&normalized, "", 0);
+	while (*line != '\0'){
+		const char *line_End = strchr(line, '\n');
+		size_t line_Length = line_End ? (size_t)(line_End - line) + 1 : strlen(line);
+		const char *done_Message = strstr(line, "background pid ");
+		// the message can come right after a prompt, so look for it anywhere on the line
+		if (done_Message != NULL && done_Message < line + line_Length && strstr(done_Message, " is done: ") != NULL &&
+		    strstr(done_Message, " is done: ") < line + line_Length){
+			append_Text(&normalized, line, done_Message - line);
+		}
+		else if (done_Message != NULL && done_Message < line + line_Length &&
+		         strncmp(done_Message, "background pid is ", strlen("background pid is ")) == 0){
+			const char *after_Pid = done_Message + strlen("background pid is ");
+			while (*after_Pid >= '0' && *after_Pid <= '9'){
+				after_Pid++;
+			}
+			append_Text(&normalized, line, done_Message - line);
+			append_Text(&normalized, "background pid is #", strlen("background pid is #"));
+			append_Text(&normalized, after_Pid, line + line_Length - after_Pid);
+		}
+		else{
+			append_Text(&normalized, line, line_Length);
+		}
+		line += line_Length;
+	}
+	return normalized.text;
+}
+
+ /*************************************************************************************************************
+ * Function:  static void write_Escaped(FILE *file, const char *text)
+ * Description: Function writes text so it fits in one tab separated field
+ ***************************************************************************************************************/
+static void write_Escaped(FILE *file, const char *text){
+	for (; *text != '\0'; text++){
+		unsigned char character = (unsigned char)*text;
+		if (character == '\\'){
+			fputs("\\\\", file);
+		}
+		else if (character == '\t'){
+			fputs("\\t", file);
+		}
+		else if (character == '\n'){
+			fputs("\\n", file);
+		}
+		else if (character < 0x20 || character == 0x7f){
+			fprintf(file, "\\x%02x", character);
+		}
+		else{
+			fputc(character, file);
+		}
+	}
+}
+
+ /*************************************************************************************************************
+ * Function:  static char *read_Escaped(char *field)
+ * Description: Function undoes write_Escaped() in place
+ * returns a malloc'd copy of the unescaped field
+ ***************************************************************************************************************/
+static char *read_Escaped(char *field){
+	char *read_Position = field;
+	char *write_Position = field;
+	while (*read_Position != '\0'){
+		if (*read_Position == '\\' && read_Position[1] != '\0'){
+			read_Position++;
+			if (*read_Position == 't'){
+				*write_Position++ = '\t';
+			}
+			else if (*read_Position == 'n'){
+				*write_Position++ = '\n';
+			}
+			else if (*read_Position == 'x' && read_Position[1] != '\0' && read_Position[2] != '\0'){
+				char hex_Digits[3] = {read_Position[1], read_Position[2], '\0'};
+				*write_Position++ = (char)strtol(hex_Digits, NULL, 16);
+				read_Position += 2;
+			}
+			else{
+				*write_Position++ = *read_Position;
+			}
+			read_Position++;
+		}
+		else{
+			*write_Position++ = *read_Position++;
+		}
+	}
+	*write_Position = '\0';
+	return strdup(field);
+}
+
+ /*************************************************************************************************************
+ * Function:  static int set_Close_On_Exec(int fd)
+ * Description: Function marks a file descriptor so the shell does not inherit it
+ ***************************************************************************************************************/
+static int set_Close_On_Exec(int fd){
+	int flags = fcntl(fd, F_GETFD);
+	if (flags < 0){
+		return -1;
+	}
+	return fcntl(fd, F_SETFD, flags | FD_CLOEXEC);
+}
+
+ /*************************************************************************************************************
+ * Function:  static void drain_Output(struct shell_Process *shell, struct text_Buffer *output)
+ * Description: Function reads the output that is in the pipe right now without waiting for more. We never
+ * read the output pipe to end of file, background commands of the shell hold it open after the shell is done.
+ * Parameters: shell and the buffer to add the output to, NULL to throw it away
+ ***************************************************************************************************************/
+static void drain_Output(struct shell_Process *shell, struct text_Buffer *output){
+	char read_Buffer[4096];
+	int flags = fcntl(shell->output_Fd, F_GETFL);
+	ssize_t bytes_Read;
+	fcntl(shell->output_Fd, F_SETFL, flags | O_NONBLOCK);
+	while ((bytes_Read = read(shell->output_Fd, read_Buffer, sizeof(read_Buffer))) > 0){
+		if (output != NULL){
+			append_Text(output, read_Buffer, bytes_Read);
+		}
+	}
+	fcntl(shell->output_Fd, F_SETFL, flags);
+}
+
+ /*************************************************************************************************************
+ * Function:  static int start_Shell(const char *shell_Path, struct shell_Process *shell)
+ * Description: Function starts smallsh in a new session with pipes for input, output and line status
+ * returns 0 - on success, returns -1 - if the pipes or fork() failed
+ ***************************************************************************************************************/
+static int start_Shell(const char *shell_Path, struct shell_Process *shell){
+	int input_Pipe[2];
+	int output_Pipe[2];
+	int status_Pipe[2];
+	int i;
+	if (pipe(input_Pipe) < 0 || pipe(output_Pipe) < 0 || pipe(status_Pipe) < 0){
+		return -1;
+	}
+	for (i = 0; i < 2; i++){
+		set_Close_On_Exec(input_Pipe[i]);
+		set_Close_On_Exec(output_Pipe[i]);
+		set_Close_On_Exec(status_Pipe[i]);
+	}
+	memset(shell, 0, sizeof(*shell));
+	shell->pid = fork();
+	switch (shell->pid){
+		case -1:
+			return -1;
+		case 0:{
+			// move our ends out of the way first, a pipe may have been given descriptor 0 to 3
+			int shell_Input = fcntl(input_Pipe[0], F_DUPFD, 10);
+			int shell_Output = fcntl(output_Pipe[1], F_DUPFD, 10);
+			int shell_Status = fcntl(status_Pipe[1], F_DUPFD, 10);
+			// a new session has no controlling terminal, so smallsh can not fall back to /dev/tty
+			setsid();
+			if (dup2(shell_Input, 0) < 0 || dup2(shell_Output, 1) < 0 || dup2(shell_Output, 2) < 0 || dup2(shell_Status, 3) < 0){
+				_exit(127);
+			}
+			close(shell_Input);
+			close(shell_Output);
+			close(shell_Status);
+			setenv("SMALLSH_STATUS_FD", "3", 1);
+			signal(SIGPIPE, SIG_DFL);
+			execl(shell_Path, shell_Path, (char *)NULL);
+			fprintf(stderr, "%s: %s\n", shell_Path, strerror(errno));
+			_exit(127);
+		}
+		default:
+			break;
+	}
+	close(input_Pipe[0]);
+	close(output_Pipe[1]);
+	close(status_Pipe[1]);
+	shell->input_Fd = input_Pipe[1];
+	shell->output_Fd = output_Pipe[0];
+	shell->status_Fd = status_Pipe[0];
+	return 0;
+}
+
+ /*************************************************************************************************************
+ * Function:  static int run_Line(struct shell_Process *shell, const char *input, struct text_Buffer *output,
+ *                                 int *exit_Value, int *signal_Number)
+ * Description: Function sends one line to the shell and collects its output until the shell reports the
+ * line on its status descriptor. If the shell exits instead (the exit command) the exit value is the
+ * exit status of the shell.
+ * returns 1 - the line is done, returns 0 - the shell exited, returns -1 - error
+ ***************************************************************************************************************/
+static int run_Line(struct shell_Process *shell, const char *input, struct text_Buffer *output, int *exit_Value, int *signal_Number){
+	char read_Buffer[4096];
+	size_t input_Length = strlen(input);
+	output->length = 0;
+	append_Text(output, "", 0);
+	if (write(shell->input_Fd, input, input_Length) != (ssize_t)input_Length || write(shell->input_Fd, "\n", 1) != 1){
+		// the shell is gone, collect what it left behind below
+		if (errno != EPIPE){
+			return -1;
+		}
+	}
+	while (1){
+		struct pollfd poll_Fds[2];
+		char *line_End;
+		poll_Fds[0].fd = shell->status_Fd;
+		poll_Fds[0].events = POLLIN;
+		poll_Fds[1].fd = shell->output_Fd;
+		poll_Fds[1].events = POLLIN;
+		if (poll(poll_Fds, 2, -1) < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			return -1;
+		}
+		// keep the output pipe empty, the shell would block on a full pipe before it reports the status
+		if (poll_Fds[1].revents != 0){
+			ssize_t bytes_Read = read(shell->output_Fd, read_Buffer, sizeof(read_Buffer));
+			if (bytes_Read > 0){
+				append_Text(output, read_Buffer, bytes_Read);
+			}
+		}
+		if (poll_Fds[0].revents != 0){
+			ssize_t bytes_Read = read(shell->status_Fd, shell->status_Buffer + shell->status_Length,
+			                          sizeof(shell->status_Buffer) - shell->status_Length - 1);
+			if (bytes_Read <= 0){
+				// only the shell has the status descriptor, so it has exited and everything it printed is
+				//in the output pipe by now
+				int status = 0;
+				waitpid(shell->pid, &status, 0);
+				shell->pid = -1;
+				drain_Output(shell, output);
+				*exit_Value = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+				*signal_Number = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+				return 0;
+			}
+			shell->status_Length += bytes_Read;
+			shell->status_Buffer[shell->status_Length] = '\0';
+		}
+		line_End = strchr(shell->status_Buffer, '\n');
+		if (line_End != NULL){
+			// the shell flushed its output before reporting, so whatever the line printed is waiting for us
+			drain_Output(shell, output);
+			if (sscanf(shell->status_Buffer, "%d %d", exit_Value, signal_Number) != 2){
+				return -1;
+			}
+			shell->status_Length -= (line_End + 1 - shell->status_Buffer);
+			memmove(shell->status_Buffer, line_End + 1, shell->status_Length + 1);
+			return 1;
+		}
+	}
+}
+
+ /*************************************************************************************************************
+ * Function:  static void stop_Shell(struct shell_Process *shell)
+ * Description: Function closes the input of the shell so it exits at end of file, and reaps it
+ ***************************************************************************************************************/
+static void stop_Shell(struct shell_Process *shell){
+	char read_Buffer[4096];
+	close(shell->input_Fd);
+	// the status descriptor reaches end of file when the shell exits. Meanwhile we throw its output away
+	//so it is never stuck writing to us
+	while (shell->pid > 0){
+		struct pollfd poll_Fds[2];
+		ssize_t bytes_Read;
+		poll_Fds[0].fd = shell->status_Fd;
+		poll_Fds[0].events = POLLIN;
+		poll_Fds[1].fd = shell->output_Fd;
+		poll_Fds[1].events = POLLIN;
+		if (poll(poll_Fds, 2, -1) < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			break;
+		}
+		if (poll_Fds[1].revents != 0){
+			drain_Output(shell, NULL);
+		}
+		if (poll_Fds[0].revents != 0){
+			bytes_Read = read(shell->status_Fd, read_Buffer, sizeof(read_Buffer));
+			if (bytes_Read == 0 || (bytes_Read < 0 && errno != EINTR)){
+				break;
+			}
+		}
+	}
+	if (shell->pid > 0){
+		waitpid(shell->pid, NULL, 0);
+	}
+	close(shell->output_Fd);
+	close(shell->status_Fd);
+}
+
+ /*************************************************************************************************************
+ * Function:  static int record_Session(const char *session_Path, const char *shell_Path)
+ * Description: Function runs the shell on our standard input, shows its output and writes the session file
+ ***************************************************************************************************************/
+static int record_Session(const char *session_Path, const char *shell_Path){
+	struct shell_Process shell;
+	struct text_Buffer output = {NULL, 0, 0};
+	char input[MAX_CHARACTERS];
+	long long session_Start;
+	int line_Count = 0;
+	FILE *session_File = fopen(session_Path, "w");
+	if (session_File == NULL){
+		perror(session_Path);
+		return 2;
+	}
+	if (start_Shell(shell_Path, &shell) < 0){
+		perror("smallsh_replay");
+		return 2;
+	}
+	fprintf(session_File, "%s\n", SESSION_HEADER);
+	session_Start = microseconds_Now();
+	while (fgets(input, sizeof(input), stdin) != NULL){
+		int exit_Value = 0;
+		int signal_Number = 0;
+		int result;
+		long long line_Start = microseconds_Now();
+		char *normalized;
+		input[strcspn(input, "\n")] = '\0';
+		result = run_Line(&shell, input, &output, &exit_Value, &signal_Number);
+		if (result < 0){
+			perror("smallsh_replay");
+			break;
+		}
+		// show the user what the shell printed, as if they were typing into it
+		fwrite(output.text, 1, output.length, stdout);
+		fflush(stdout);
+		normalized = normalize_Output(output.text);
+		fprintf(session_File, "%lld\t%lld\t%d\t%d\t", line_Start - session_Start, microseconds_Now() - line_Start, exit_Value, signal_Number);
+		write_Escaped(session_File, input);
+		fputc('\t', session_File);
+		write_Escaped(session_File, normalized);
+		fputc('\n', session_File);
+		free(normalized);
+		line_Count++;
+		if (result == 0){
+			break;
+		}
+	}
+	stop_Shell(&shell);
+	free(output.text);
+	if (fclose(session_File) != 0){
+		perror(session_Path);
+		return 2;
+	}
+	fprintf(stderr, "smallsh_replay: recorded %d lines to %s\n", line_Count, session_Path);
+	return 0;
+}
+
+ /*************************************************************************************************************
+ * Function:  static int load_Session(const char *session_Path, struct session_Line **lines)
+ * Description: Function reads a session file written by record_Session()
+ * returns the number of lines, or -1 if the file could not be read
+ ***************************************************************************************************************/
+static int load_Session(const char *session_Path, struct session_Line **lines){
+	FILE *session_File = fopen(session_Path, "r");
+	struct text_Buffer file_Line = {NULL, 0, 0};
+	char read_Buffer[4096];
+	int line_Count = 0;
+	int line_Capacity = 0;
+	int line_Number = 0;
+	*lines = NULL;
+	if (session_File == NULL){
+		perror(session_Path);
+		return -1;
+	}
+	// lines can be longer than any buffer because of the output field, so they are put together piece by piece
+	while (fgets(read_Buffer, sizeof(read_Buffer), session_File) != NULL){
+		char *fields[6];
+		char *field_End;
+		int i;
+		append_Text(&file_Line, read_Buffer, strlen(read_Buffer));
+		if (file_Line.text[file_Line.length - 1] != '\n' && !feof(session_File)){
+			continue;
+		}
+		line_Number++;
+		file_Line.text[strcspn(file_Line.text, "\n")] = '\0';
+		if (line_Number == 1 && strcmp(file_Line.text, SESSION_HEADER) != 0){
+			fprintf(stderr, "%s: not a smallsh session file\n", session_Path);
+			fclose(session_File);
+			return -1;
+		}
+		if (line_Number == 1 || file_Line.text[0] == '\0'){
+			file_Line.length = 0;
+			continue;
+		}
+		fields[0] = file_Line.text;
+		for (i = 1; i < 6; i++){
+			field_End = strchr(fields[i - 1], '\t');
+			if (field_End == NULL){
+				fprintf(stderr, "%s:%d: expected 6 tab separated fields\n", session_Path, line_Number);
+				fclose(session_File);
+				return -1;
+			}
+			*field_End = '\0';
+			fields[i] = field_End + 1;
+		}
+		if (line_Count == line_Capacity){
+			line_Capacity = line_Capacity ? line_Capacity * 2 : 64;
+			*lines = realloc(*lines, line_Capacity * sizeof(**lines));
+			if (*lines == NULL){
+				perror("smallsh_replay");
+				exit(2);
+			}
+		}
+		(*lines)[line_Count].offset_Us = atoll(fields[0]);
+		(*lines)[line_Count].latency_Us = atoll(fields[1]);
+		(*lines)[line_Count].exit_Value = atoi(fields[2]);
+		(*lines)[line_Count].signal_Number = atoi(fields[3]);
+		(*lines)[line_Count].input = read_Escaped(fields[4]);
+		(*lines)[line_Count].output = read_Escaped(fields[5]);
+		line_Count++;
+		file_Line.length = 0;
+	}
+	free(file_Line.text);
+	fclose(session_File);
+	return line_Count;
+}
+
+ /*************************************************************************************************************
+ * Function:  static void sleep_Until(long long wake_Us)
+ * Description: Function sleeps until the microseconds_Now() time stamp wake_Us
+ ***************************************************************************************************************/
+static void sleep_Until(long long wake_Us){
+	long long remaining = wake_Us - microseconds_Now();
+	while (remaining > 0){
+		struct timespec pause_Time;
+		pause_Time.tv_sec = remaining / 1000000;
+		pause_Time.tv_nsec = (remaining % 1000000) * 1000;
+		nanosleep(&pause_Time, NULL);
+		remaining = wake_Us - microseconds_Now();
+	}
+}
+
+ /*************************************************************************************************************
+ * Function:  static int replay_Worker(const struct session_Line *lines, int line_Count, const char *shell_Path,
+ *                                     double speed, int iterations, int shell_Number, long long *latencies)
+ * Description: Function replays the session iterations times on one shell, a new shell for every iteration.
+ * speed 1 keeps the recorded pace, 2 goes twice as fast and 0 sends every line as soon as the last one is done.
+ * The latency of every line is stored in latencies, -1 for lines that were never sent.
+ * returns the number of lines that diverged from the recording, or -1 on error
+ ***************************************************************************************************************/
+static int replay_Worker(const struct session_Line *lines, int line_Count, const char *shell_Path, double speed,
+                         int iterations, int shell_Number, long long *latencies){
+	struct text_Buffer output = {NULL, 0, 0};
+	int divergences = 0;
+	int iteration;
+	int i;
+	for (i = 0; i < line_Count * iterations; i++){
+		latencies[i] = -1;
+	}
+	for (iteration = 0; iteration < iterations; iteration++){
+		struct shell_Process shell;
+		long long session_Start;
+		int shell_Running = 1;
+		if (start_Shell(shell_Path, &shell) < 0){
+			perror("smallsh_replay");
+			return -1;
+		}
+		session_Start = microseconds_Now();
+		for (i = 0; i < line_Count && shell_Running; i++){
+			int exit_Value = 0;
+			int signal_Number = 0;
+			int result;
+			long long line_Start;
+			char *normalized;
+			if (speed > 0){
+				sleep_Until(session_Start + (long long)(lines[i].offset_Us / speed));
+			}
+			line_Start = microseconds_Now();
+			result = run_Line(&shell, lines[i].input, &output, &exit_Value, &signal_Number);
+			if (result < 0){
+				perror("smallsh_replay");
+				stop_Shell(&shell);
+				free(output.text);
+				return -1;
+			}
+			latencies[iteration * line_Count + i] = microseconds_Now() - line_Start;
+			shell_Running = (result == 1);
+			normalized = normalize_Output(output.text);
+			if (exit_Value != lines[i].exit_Value || signal_Number != lines[i].signal_Number || strcmp(normalized, lines[i].output) != 0){
+				if (divergences < MAX_REPORTED_DIVERGENCES){
+					fprintf(stderr, "shell %d, iteration %d, line %d: %s\n", shell_Number, iteration + 1, i + 1, lines[i].input);
+					fprintf(stderr, "  expected exit %d signal %d output \"", lines[i].exit_Value, lines[i].signal_Number);
+					write_Escaped(stderr, lines[i].output);
+					fprintf(stderr, "\"\n  got      exit %d signal %d output \"", exit_Value, signal_Number);
+					write_Escaped(stderr, normalized);
+					fprintf(stderr, "\"\n");
+				}
+				divergences++;
+			}
+			free(normalized);
+		}
+		// the shell exited before the end of the session, the rest of the lines diverge
+		if (i < line_Count){
+			if (divergences < MAX_REPORTED_DIVERGENCES){
+				fprintf(stderr, "shell %d, iteration %d: shell exited after line %d of %d\n", shell_Number, iteration + 1, i, line_Count);
+			}
+			divergences += line_Count - i;
+		}
+		stop_Shell(&shell);
+	}
+	free(output.text);
+	return divergences;
+}
+
+ /*************************************************************************************************************
+ * Function:  static int compare_Latencies(const void *first, const void *second)
+ * Description: qsort() comparison for latencies
+ ***************************************************************************************************************/
+static int compare_Latencies(const void *first, const void *second){
+	long long a = *(const long long *)first;
+	long long b = *(const long long *)second;
+	return (a > b) - (a < b);
+}
+
+ /*************************************************************************************************************
+ * Function:  static int replay_Session(const char *session_Path, const char *shell_Path, double speed,
+ *                                      int shell_Count, int iterations)
+ * Description: Function forks one worker per shell, collects their latencies and divergence counts through
+ * pipes and prints the report
+ ***************************************************************************************************************/
+static int replay_Session(const char *session_Path, const char *shell_Path, double speed, int shell_Count, int iterations){
+	struct session_Line *lines;
+	int line_Count = load_Session(session_Path, &lines);
+	size_t results_Per_Shell;
+	long long *latencies;
+	size_t latency_Count = 0;
+	long long latency_Sum = 0;
+	int total_Divergences = 0;
+	int failed_Shells = 0;
+	int *result_Fds;
+	pid_t *worker_Pids;
+	long long replay_Start;
+	double elapsed_Seconds;
+	size_t i;
+	int shell_Number;
+	if (line_Count < 0){
+		return 2;
+	}
+	if (line_Count == 0){
+		fprintf(stderr, "%s: no lines to replay\n", session_Path);
+		return 2;
+	}
+	results_Per_Shell = (size_t)line_Count * iterations;
+	latencies = malloc(results_Per_Shell * shell_Count * sizeof(long long));
+	result_Fds = malloc(shell_Count * sizeof(int));
+	worker_Pids = malloc(shell_Count * sizeof(pid_t));
+	if (latencies == NULL || result_Fds == NULL || worker_Pids == NULL){
+		perror("smallsh_replay");
+		return 2;
+	}
+	replay_Start = microseconds_Now();
+	for (shell_Number = 0; shell_Number < shell_Count; shell_Number++){
+		int result_Pipe[2];
+		if (pipe(result_Pipe) < 0){
+			perror("smallsh_replay");
+			return 2;
+		}
+		worker_Pids[shell_Number] = fork();
+		if (worker_Pids[shell_Number] < 0){
+			perror("smallsh_replay");
+			return 2;
+		}
+		if (worker_Pids[shell_Number] == 0){
+			// the worker keeps its results until the end, so it never waits on the parent while replaying
+			long long *worker_Latencies = latencies + results_Per_Shell * shell_Number;
+			int divergences;
+			size_t bytes_Left = results_Per_Shell * sizeof(long long);
+			char *write_Position = (char *)worker_Latencies;
+			close(result_Pipe[0]);
+			divergences = replay_Worker(lines, line_Count, shell_Path, speed, iterations, shell_Number + 1, worker_Latencies);
+			if (write(result_Pipe[1], &divergences, sizeof(divergences)) != sizeof(divergences)){
+				_exit(2);
+			}
+			while (bytes_Left > 0){
+				ssize_t bytes_Written = write(result_Pipe[1], write_Position, bytes_Left);
+				if (bytes_Written <= 0){
+					_exit(2);
+				}
+				write_Position += bytes_Written;
+				bytes_Left -= bytes_Written;
+			}
+			_exit(0);
+		}
+		close(result_Pipe[1]);
+		result_Fds[shell_Number] = result_Pipe[0];
+	}
+	for (shell_Number = 0; shell_Number < shell_Count; shell_Number++){
+		int divergences = -1;
+		char *read_Position = (char *)(latencies + results_Per_Shell * shell_Number);
+		size_t bytes_Left = results_Per_Shell * sizeof(long long);
+		if (read(result_Fds[shell_Number], &divergences, sizeof(divergences)) != sizeof(divergences) || divergences < 0){
+			failed_Shells++;
+			divergences = 0;
+			bytes_Left = 0;
+			for (i = 0; i < results_Per_Shell; i++){
+				latencies[results_Per_Shell * shell_Number + i] = -1;
+			}
+		}
+		while (bytes_Left > 0){
+			ssize_t bytes_Read = read(result_Fds[shell_Number], read_Position, bytes_Left);
+			if (bytes_Read <= 0){
+				failed_Shells++;
+				for (i = 0; i < results_Per_Shell; i++){
+					latencies[results_Per_Shell * shell_Number + i] = -1;
+				}
+				break;
+			}
+			read_Position += bytes_Read;
+			bytes_Left -= bytes_Read;
+		}
+		total_Divergences += divergences;
+		close(result_Fds[shell_Number]);
+		waitpid(worker_Pids[shell_Number], NULL, 0);
+	}
+	elapsed_Seconds = (microseconds_Now() - replay_Start) / 1e6;
+	// the lines that were never sent (shell exited early or a worker failed) are left out of the latencies
+	for (i = 0; i < results_Per_Shell * shell_Count; i++){
+		if (latencies[i] >= 0){
+			latencies[latency_Count++] = latencies[i];
+			latency_Sum += latencies[i];
+		}
+	}
+	qsort(latencies, latency_Count, sizeof(long long), compare_Latencies);
+	printf("session:      %s (%d lines)\n", session_Path, line_Count);
+	printf("shells:       %d, iterations: %d, speed: ", shell_Count, iterations);
+	if (speed > 0){
+		printf("%gx\n", speed);
+	}
+	else{
+		printf("max\n");
+	}
+	printf("lines run:    %zu in %.3f s\n", latency_Count, elapsed_Seconds);
+	printf("throughput:   %.1f lines/s\n", elapsed_Seconds > 0 ? latency_Count / elapsed_Seconds : 0.0);
+	if (latency_Count > 0){
+		printf("latency (ms): mean %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+		       latency_Sum / 1e3 / latency_Count,
+		       latencies[(latency_Count - 1) * 50 / 100] / 1e3,
+		       latencies[(latency_Count - 1) * 90 / 100] / 1e3,
+		       latencies[(latency_Count - 1) * 99 / 100] / 1e3,
+		       latencies[latency_Count - 1] / 1e3);
+	}
+	printf("divergences:  %d\n", total_Divergences);
+	if (failed_Shells > 0){
+		printf("failed shells: %d\n", failed_Shells);
+	}
+	for (i = 0; i < (size_t)line_Count; i++){
+		free(lines[i].input);
+		free(lines[i].output);
+	}
+	free(lines);
+	free(latencies);
+	free(result_Fds);
+	free(worker_Pids);
+	if (failed_Shells > 0){
+		return 2;
+	}
+	return total_Divergences > 0 ? 1 : 0;
+}
+
+ /*************************************************************************************************************
+ * Function:  static void print_Usage(void)
+ * Description: Function shows how to run the program
+ ***************************************************************************************************************/
+static void print_Usage(void){
+	fprintf(stderr, "usage: smallsh_replay record SESSION_FILE [--shell PATH]\n"
+	                "       smallsh_replay replay SESSION_FILE [--shell PATH] [--speed original|max|FACTOR]\n"
+	                "                             [--shells N] [--iterations K]\n");
+}
+
+/******************************************************************************************************************
+MAIN FUNCTION
+ * ****************************************************************************************************************/
+int main(int argc, char *argv[]){
+	const char *shell_Path = "./smallsh";
+	double speed = 1;
+	int shell_Count = 1;
+	int iterations = 1;
+	int i;
+	if (argc < 3){
+		print_Usage();
+		return 2;
+	}
+	for (i = 3; i < argc; i++){
+		if (i + 1 >= argc){
+			print_Usage();
+			return 2;
+		}
+		if (strcmp(argv[i], "--shell") == 0){
+			shell_Path = argv[++i];
+		}
+		else if (strcmp(argv[i], "--speed") == 0){
+			i++;
+			if (strcmp(argv[i], "original") == 0){
+				speed = 1;
+			}
+			else if (strcmp(argv[i], "max") == 0){
+				speed = 0;
+			}
+			else{
+				// the whole word has to be a number, atof() would make "fast" 0, which is max
+				char *number_End;
+				speed = strtod(argv[i], &number_End);
+				if (number_End == argv[i] || *number_End != '\0' || !(speed > 0)){
+					fprintf(stderr, "smallsh_replay: --speed must be original, max or a number above 0, not %s\n", argv[i]);
+					print_Usage();
+					return 2;
+				}
+			}
+		}
+		else if (strcmp(argv[i], "--shells") == 0){
+			shell_Count = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--iterations") == 0){
+			iterations = atoi(argv[++i]);
+		}
+		else{
+			print_Usage();
+			return 2;
+		}
+	}
+	if (speed < 0 || shell_Count < 1 || iterations < 1){
+		print_Usage();
+		return 2;
+	}
+	// a shell that exits early closes its input, we find out from the status pipe instead of dying
+	signal(SIGPIPE, SIG_IGN);
+	if (strcmp(argv[1], "record") == 0){
+		return record_Session(argv[2], shell_Path);
+	}
+	if (strcmp(argv[1], "replay") == 0){
+		return replay_Session(argv[2], shell_Path, speed, shell_Count, iterations);
+	}
+	print_Usage();
+	return 2;
+}
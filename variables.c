@@ -0,0 +1,291 @@
+/*********************************************************************************************************
+* Tatyana Vlaskin (vlaskint@onid.oregonstate.edu)
+* OregonState EECS
+* Filename: variables.c
+*
+* Description: Hash table of shell and environment variables, see variables.h for the interface.
+* The hash function is FNV-1a, http://www.isthe.com/chongo/tech/comp/fnv/
+******************************************************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "variables.h"
+
+#define INITIAL_BUCKETS 64
+
+ /*************************************************************************************************************
+ * Function:  static unsigned int hash_Name(const char *name, size_t name_Length)
+ * Description: Function computes the FNV-1a hash of a variable name
+ ***************************************************************************************************************/
+static unsigned int hash_Name(const char *name, size_t name_Length){
+	unsigned int hash = 2166136261u;
+	size_t i;
+	for (i = 0; i < name_Length; i++){
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+ /*************************************************************************************************************
+ * Function:  static struct shell_Variable **find_Variable(const struct variable_Store *store, const char *name,
+ *                                                           size_t name_Length, unsigned int hash)
+ * Description: Function finds the link that points to the variable, so it can be replaced or removed
+ * returns the link, *link is NULL if the variable is not set
+ ***************************************************************************************************************/
+static struct shell_Variable **find_Variable(const struct variable_Store *store, const char *name, size_t name_Length, unsigned int hash){
+	struct shell_Variable **link = &store->buckets[hash & (store->bucket_Count - 1)];
+	while (*link != NULL){
+		if ((*link)->hash == hash && (*link)->name_Length == name_Length && strncmp((*link)->entry, name, name_Length) == 0){
+			break;
+		}
+		link = &(*link)->next;
+	}
+	return link;
+}
+
+ /*************************************************************************************************************
+ * Function:  static int grow_Buckets(struct variable_Store *store)
+ * Description: Function doubles the number of buckets and moves every variable to its new bucket
+ ***************************************************************************************************************/
+static int grow_Buckets(struct variable_Store *store){
+	size_t new_Count = store->bucket_Count * 2;
+	struct shell_Variable **new_Buckets = calloc(new_Count, sizeof(*new_Buckets));
+	size_t i;
+	if (new_Buckets == NULL){
+		return -1;
+	}
+	for (i = 0; i < store->bucket_Count; i++){
+		struct shell_Variable *variable = store->buckets[i];
+		while (variable != NULL){
+			struct shell_Variable *next = variable->next;
+			variable->next = new_Buckets[variable->hash & (new_Count - 1)];
+			new_Buckets[variable->hash & (new_Count - 1)] = variable;
+			variable = next;
+		}
+	}
+	free(store->buckets);
+	store->buckets = new_Buckets;
+	store->bucket_Count = new_Count;
+	return 0;
+}
+
+ /*************************************************************************************************************
+ * Function:  static int store_Variable(struct variable_Store *store, const char *name, size_t name_Length,
+ *                                       const char *value, int exported)
+ * Description: Function does the work of set_Variable() for a name that is not NUL terminated.
+ * value NULL only changes the exported setting, creating a variable without a value if it is not set.
+ ***************************************************************************************************************/
+static int store_Variable(struct variable_Store *store, const char *name, size_t name_Length, const char *value, int exported){
+	unsigned int hash = hash_Name(name, name_Length);
+	struct shell_Variable **link;
+	struct shell_Variable *variable;
+	if (!valid_Variable_Name(name, name_Length)){
+		return -1;
+	}
+	link = find_Variable(store, name, name_Length, hash);
+	variable = *link;
+	if (variable == NULL){
+		if (store->variable_Count >= store->bucket_Count * 2 && grow_Buckets(store) == 0){
+			link = find_Variable(store, name, name_Length, hash);
+		}
+		variable = calloc(1, sizeof(*variable));
+		if (variable == NULL){
+			return -1;
+		}
+		variable->name_Length = name_Length;
+		variable->hash = hash;
+		*link = variable;
+		store->variable_Count++;
+	}
+	if (value != NULL || variable->entry == NULL){
+		// NAME=value in one string, so the environment array can point straight at it
+		//a variable without a value is only NAME, it is not put in the environment array
+		size_t value_Length = value != NULL ? strlen(value) : 0;
+		char *entry = malloc(name_Length + 1 + value_Length + 1);
+		if (entry == NULL){
+			if (variable->entry == NULL){
+				*link = variable->next;
+				store->variable_Count--;
+				free(variable);
+			}
+			return -1;
+		}
+		memcpy(entry, name, name_Length);
+		entry[name_Length] = '\0';
+		if (value != NULL){
+			entry[name_Length] = '=';
+			memcpy(entry + name_Length + 1, value, value_Length + 1);
+		}
+		free(variable->entry);
+		variable->entry = entry;
+		variable->has_Value = (value != NULL);
+		// the cached environment still points at the old entry, or does not have the variable yet
+		if (variable->exported){
+			store->environment_Changed = 1;
+		}
+	}
+	if (exported >= 0 && exported != variable->exported){
+		variable->exported = exported;
+		if (exported){
+			store->exported_Count++;
+		}
+		else{
+			store->exported_Count--;
+		}
+		store->environment_Changed = 1;
+	}
+	return 0;
+}
+
+ /*************************************************************************************************************
+ * Function:  static int add_Passthrough(struct variable_Store *store, const char *entry)
+ * Description: Function keeps a copy of an environment entry that can not be a variable
+ * returns 0 - on success, returns -1 - if we ran out of memory
+ ***************************************************************************************************************/
+static int add_Passthrough(struct variable_Store *store, const char *entry){
+	char **new_Passthrough = realloc(store->passthrough, (store->passthrough_Count + 1) * sizeof(char *));
+	if (new_Passthrough == NULL){
+		return -1;
+	}
+	store->passthrough = new_Passthrough;
+	store->passthrough[store->passthrough_Count] = strdup(entry);
+	if (store->passthrough[store->passthrough_Count] == NULL){
+		return -1;
+	}
+	store->passthrough_Count++;
+	return 0;
+}
+
+int init_Variable_Store(struct variable_Store *store, char **environment){
+	memset(store, 0, sizeof(*store));
+	store->buckets = calloc(INITIAL_BUCKETS, sizeof(*store->buckets));
+	if (store->buckets == NULL){
+		return -1;
+	}
+	store->bucket_Count = INITIAL_BUCKETS;
+	store->environment_Changed = 1;
+	while (environment != NULL && *environment != NULL){
+		// entries without = or with odd names can not be variables, but the commands we launch still get them
+		//like they would without us in between
+		const char *equal_Sign = strchr(*environment, '=');
+		if (equal_Sign == NULL || !valid_Variable_Name(*environment, equal_Sign - *environment)){
+			if (add_Passthrough(store, *environment) < 0){
+				return -1;
+			}
+		}
+		else{
+			set_Variable_Assignment(store, *environment, 1);
+		}
+		environment++;
+	}
+	return 0;
+}
+
+void free_Variable_Store(struct variable_Store *store){
+	size_t i;
+	for (i = 0; i < store->bucket_Count; i++){
+		struct shell_Variable *variable = store->buckets[i];
+		while (variable != NULL){
+			struct shell_Variable *next = variable->next;
+			free(variable->entry);
+			free(variable);
+			variable = next;
+		}
+	}
+	for (i = 0; i < store->passthrough_Count; i++){
+		free(store->passthrough[i]);
+	}
+	free(store->passthrough);
+	free(store->buckets);
+	free(store->envp);
+	memset(store, 0, sizeof(*store));
+}
+
+int valid_Variable_Name(const char *name, size_t name_Length){
+	size_t i;
+	if (name_Length == 0 || isdigit((unsigned char)name[0])){
+		return 0;
+	}
+	for (i = 0; i < name_Length; i++){
+		if (!isalnum((unsigned char)name[i]) && name[i] != '_'){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+const char *get_Variable(const struct variable_Store *store, const char *name){
+	size_t name_Length = strlen(name);
+	struct shell_Variable *variable = *find_Variable(store, name, name_Length, hash_Name(name, name_Length));
+	if (variable == NULL || !variable->has_Value){
+		return NULL;
+	}
+	return variable->entry + variable->name_Length + 1;
+}
+
+int set_Variable(struct variable_Store *store, const char *name, const char *value, int exported){
+	return store_Variable(store, name, strlen(name), value, exported);
+}
+
+int set_Variable_Assignment(struct variable_Store *store, const char *assignment, int exported){
+	const char *equal_Sign = strchr(assignment, '=');
+	if (equal_Sign == NULL){
+		return store_Variable(store, assignment, strlen(assignment), NULL, exported);
+	}
+	return store_Variable(store, assignment, equal_Sign - assignment, equal_Sign + 1, exported);
+}
+
+int unset_Variable(struct variable_Store *store, const char *name){
+	size_t name_Length = strlen(name);
+	struct shell_Variable **link;
+	struct shell_Variable *variable;
+	if (!valid_Variable_Name(name, name_Length)){
+		return -1;
+	}
+	link = find_Variable(store, name, name_Length, hash_Name(name, name_Length));
+	variable = *link;
+	if (variable == NULL){
+		return 0;
+	}
+	*link = variable->next;
+	if (variable->exported){
+		store->exported_Count--;
+		store->environment_Changed = 1;
+	}
+	store->variable_Count--;
+	free(variable->entry);
+	free(variable);
+	return 0;
+}
+
+char **variable_Environment(struct variable_Store *store){
+	size_t i;
+	size_t entry_Number = 0;
+	char **new_Envp;
+	if (!store->environment_Changed && store->envp != NULL){
+		return store->envp;
+	}
+	// only pointers are copied, the strings are the NAME=value entries of the variables.
+	//exported_Count also counts the exported variables without a value, so there is always room
+	new_Envp = realloc(store->envp, (store->exported_Count + store->passthrough_Count + 1) * sizeof(char *));
+	if (new_Envp == NULL){
+		return NULL;
+	}
+	store->envp = new_Envp;
+	for (i = 0; i < store->bucket_Count; i++){
+		struct shell_Variable *variable;
+		for (variable = store->buckets[i]; variable != NULL; variable = variable->next){
+			if (variable->exported && variable->has_Value){
+				store->envp[entry_Number++] = variable->entry;
+			}
+		}
+	}
+	for (i = 0; i < store->passthrough_Count; i++){
+		store->envp[entry_Number++] = store->passthrough[i];
+	}
+	store->envp[entry_Number] = NULL;
+	store->environment_Changed = 0;
+	return store->envp;
+}
@@ -0,0 +1,113 @@
+/*********************************************************************************************************
+* Tatyana Vlaskin (vlaskint@onid.oregonstate.edu)
+* OregonState EECS
+* Filename: variables.h
+*
+* Description: Store for shell and environment variables.
+* 1. variables are kept in a hash table, each one as a single "NAME=value" string so that string can be
+*    put in the environment array as it is
+* 2. exported variables go to the environment of the commands we launch, the others are only shell variables
+* 3. variable_Environment() returns an envp array for execve. The array is only rebuilt when an exported
+*    variable changed since the last call, otherwise the same array is handed out again, so launching many
+*    commands does not copy a large environment every time
+* 4. environment entries that are not NAME=value with a valid name (A-B=1, exported bash functions like
+*    BASH_FUNC_f%%=...) can not be shell variables, they are kept as they are and passed on to every command
+* Functions return 0 on success and -1 on failure (invalid name or out of memory).
+******************************************************************************************************************/
+#ifndef VARIABLES_H
+#define VARIABLES_H
+
+#include <stddef.h>
+
+/*************************************************************************************************************
+ * Structure: struct shell_Variable
+ * Description: One variable, entry is "NAME=value" and the value starts at entry + name_Length + 1.
+ * A variable that was exported before it was ever set has no value, entry is then only "NAME" and has_Value is 0.
+ ***************************************************************************************************************/
+struct shell_Variable {
+	char *entry;
+	size_t name_Length;
+	unsigned int hash;
+	int exported;
+	int has_Value;
+	struct shell_Variable *next;
+};
+
+/*************************************************************************************************************
+ * Structure: struct variable_Store
+ * Description: Hash table of variables with separate chaining. bucket_Count is a power of two and the
+ * table doubles when it holds more than two variables per bucket.
+ * envp is the cached environment array, environment_Changed is set when it has to be rebuilt.
+ * passthrough holds copies of the imported environment entries that are not variables, they go at the end of envp.
+ ***************************************************************************************************************/
+struct variable_Store {
+	struct shell_Variable **buckets;
+	size_t bucket_Count;
+	size_t variable_Count;
+	size_t exported_Count;
+	char **passthrough;
+	size_t passthrough_Count;
+	char **envp;
+	int environment_Changed;
+};
+
+ /*************************************************************************************************************
+ * Function:  int init_Variable_Store(struct variable_Store *store, char **environment)
+ * Description: Function creates the store and imports every NAME=value entry of environment as exported,
+ * the other entries are kept for passing on
+ * Parameters: store and the environment to import (usually environ), can be NULL
+ * returns 0 - on success, returns -1 - if we ran out of memory
+ ***************************************************************************************************************/
+int init_Variable_Store(struct variable_Store *store, char **environment);
+
+ /*************************************************************************************************************
+ * Function:  void free_Variable_Store(struct variable_Store *store)
+ * Description: Function frees every variable and the environment array
+ ***************************************************************************************************************/
+void free_Variable_Store(struct variable_Store *store);
+
+ /*************************************************************************************************************
+ * Function:  int valid_Variable_Name(const char *name, size_t name_Length)
+ * Description: Function checks that a name is a letter or _ followed by letters, digits and _
+ * returns 1 - if the name is valid, returns 0 - if it is not
+ ***************************************************************************************************************/
+int valid_Variable_Name(const char *name, size_t name_Length);
+
+ /*************************************************************************************************************
+ * Function:  const char *get_Variable(const struct variable_Store *store, const char *name)
+ * Description: Function looks up a variable
+ * returns the value, or NULL if the variable is not set or has no value yet
+ ***************************************************************************************************************/
+const char *get_Variable(const struct variable_Store *store, const char *name);
+
+ /*************************************************************************************************************
+ * Function:  int set_Variable(struct variable_Store *store, const char *name, const char *value, int exported)
+ * Description: Function sets a variable. exported is 1 to export it, 0 to make it a shell variable only
+ * and -1 to keep it the way it was (a new variable is then not exported), like NAME=value in sh.
+ ***************************************************************************************************************/
+int set_Variable(struct variable_Store *store, const char *name, const char *value, int exported);
+
+ /*************************************************************************************************************
+ * Function:  int set_Variable_Assignment(struct variable_Store *store, const char *assignment, int exported)
+ * Description: Function is set_Variable() for a NAME=value word, a word without = only changes the
+ * exported setting of NAME (export NAME). Exporting a NAME that is not set creates it without a value, like
+ * in sh it only goes to the environment once it is given one.
+ ***************************************************************************************************************/
+int set_Variable_Assignment(struct variable_Store *store, const char *assignment, int exported);
+
+ /*************************************************************************************************************
+ * Function:  int unset_Variable(struct variable_Store *store, const char *name)
+ * Description: Function removes a variable, removing one that is not set is not an error
+ ***************************************************************************************************************/
+int unset_Variable(struct variable_Store *store, const char *name);
+
+ /*************************************************************************************************************
+ * Function:  char **variable_Environment(struct variable_Store *store)
+ * Description: Function returns the NULL terminated environment array of all exported variables that have a value,
+ * followed by the imported entries that are not variables.
+ * The array belongs to the store and stays valid until the next change to an exported variable.
+ * returns the array, or NULL if we ran out of memory
+ ***************************************************************************************************************/
+char **variable_Environment(struct variable_Store *store);
+
+#endif